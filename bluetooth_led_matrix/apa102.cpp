@@ -0,0 +1,63 @@
+/////////////////////////////////////////////////////
+//  Functions for the Apa102Encoder
+/////////////////////////////////////////////////////
+
+#include "apa102.h"
+
+/////////////////////////////////////////////////////////////////////
+// Picks the 5 bit current level and 8 bit PWM values that come
+// closest to the wanted 8.8 values.  Output of a channel is roughly
+// pwm * level / 31, so using the smallest level the brightest channel
+// fits in leaves the most PWM steps for dim colors.  At full current
+// this is the same as plain 8 bit output.
+/////////////////////////////////////////////////////////////////////
+void Apa102Encoder::encodePixel(uint16_t r, uint16_t g, uint16_t b, uint8_t *out) {
+  uint16_t brightest = r > g ? (r > b ? r : b) : (g > b ? g : b);
+
+  if (brightest == 0) {
+    out[0] = 0xE0;
+    out[APA102_OFFSET_R] = out[APA102_OFFSET_G] = out[APA102_OFFSET_B] = 0;
+    return;
+  }
+
+  // Smallest level with brightest * 31 <= 255 * 256 * level
+  uint32_t level = ((uint32_t)brightest * 31 + (255UL << 8) - 1) / (255UL << 8);
+  if (level > 31) level = 31;
+
+  // pwm = v * 31 / (level * 256), rounded
+  uint32_t div  = level << 8;
+  uint32_t half = div >> 1;
+  uint32_t pr = ((uint32_t)r * 31 + half) / div;
+  uint32_t pg = ((uint32_t)g * 31 + half) / div;
+  uint32_t pb = ((uint32_t)b * 31 + half) / div;
+
+  out[0] = 0xE0 | level;
+  out[APA102_OFFSET_R] = pr > 255 ? 255 : pr;
+  out[APA102_OFFSET_G] = pg > 255 ? 255 : pg;
+  out[APA102_OFFSET_B] = pb > 255 ? 255 : pb;
+}
+
+void Apa102Encoder::writeStartFrame(uint8_t *out) {
+  for (uint8_t i = 0; i < APA102_START_BYTES; i++) out[i] = 0x00;
+}
+
+void Apa102Encoder::writeEndFrame(uint16_t nLeds, uint8_t *out) {
+  for (uint16_t i = 0; i < APA102_END_BYTES(nLeds); i++) out[i] = 0xFF;
+}
+
+/////////////////////////////////////////////////////
+// Writes a whole frame (start, pixels, end) for rgb,
+// which holds three 8.8 values per LED.  Returns the
+// number of bytes written.
+/////////////////////////////////////////////////////
+uint32_t Apa102Encoder::encodeFrame(const uint16_t *rgb, uint16_t nLeds, uint8_t *out) {
+  writeStartFrame(out);
+  uint8_t *p = out + APA102_START_BYTES;
+  for (uint16_t i = 0; i < nLeds; i++) {
+    encodePixel(rgb[0], rgb[1], rgb[2], p);
+    rgb += 3;
+    p += 4;
+  }
+  writeEndFrame(nLeds, p);
+  return APA102_FRAME_BYTES(nLeds);
+}
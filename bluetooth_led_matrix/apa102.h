@@ -0,0 +1,40 @@
+#ifndef __APA102
+#define __APA102
+
+#include <stdint.h>
+
+///////////////////////////////////////////////////////////////////////
+//  APA102 frame encoder.  Doesn't depend on FastLED or the Arduino
+//  core, so the exact byte stream can also be produced on a PC.
+//
+//  Frame layout: a start frame of four 0x00 bytes, then four bytes per
+//  LED (0xE0 | 5 bit current level, then the three PWM values), then an
+//  end frame of 0xFF bytes to clock the data through the whole strip.
+//  The end frame is the same length FastLED sends.
+///////////////////////////////////////////////////////////////////////
+#define APA102_START_BYTES     4
+#define APA102_END_BYTES(n)    (4 * ((n) / 32 + 1))
+#define APA102_FRAME_BYTES(n)  (APA102_START_BYTES + 4 * (n) + APA102_END_BYTES(n))
+
+// Order the color bytes go out in after the header byte.  Matches what
+// FastLED sends for addLeds<APA102, DATA_PIN, CLOCK_PIN> (RGB order).
+#define APA102_OFFSET_R  1
+#define APA102_OFFSET_G  2
+#define APA102_OFFSET_B  3
+
+class Apa102Encoder {
+
+public:
+  // Input channels are 8.8 fixed point, so 255 << 8 is full on
+  static void      encodePixel(uint16_t r, uint16_t g, uint16_t b, uint8_t *out);
+  static uint32_t  encodeFrame(const uint16_t *rgb, uint16_t nLeds, uint8_t *out);
+  static void      writeStartFrame(uint8_t *out);
+  static void      writeEndFrame(uint16_t nLeds, uint8_t *out);
+
+  // For a frame buffer that is reused: write the start and end frames once,
+  // then only the pixel data (4 bytes per LED from pixelData()) each frame
+  static void      prepareFrame(uint16_t nLeds, uint8_t *out) { writeStartFrame(out); writeEndFrame(nLeds, out + APA102_START_BYTES + 4 * nLeds); };
+  static uint8_t*  pixelData(uint8_t *out) { return out + APA102_START_BYTES; };
+};
+
+#endif
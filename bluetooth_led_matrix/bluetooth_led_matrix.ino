@@ -3,6 +3,12 @@
 
 #include <FastLED.h>
 #include "displayClass.h"
+#include "compositor.h"
+#include "transition.h"
+#include "ledOutput.h"
+#include "powerLimit.h"
+#include "effectArena.h"
+#include "panelMap.h"
 
 #define __DEBUG
 
@@ -26,35 +32,118 @@
 #define CHIPSET     APA102
 #define BRIGHTNESS  40
 
+// Set to 1 to drive the strip directly, using the APA102 5 bit current
+// control for more range at low brightness, instead of through FastLED
+#define APA102_DIRECT_OUTPUT  1
+
+// Set to 1 to send frames by SPI DMA in the background while the next one
+// is drawn.  Needs direct output and the strip moved to the hardware SPI
+// pins (11 data, 13 clock), since DATA_PIN/CLOCK_PIN can't do SPI.
+#define APA102_DMA_OUTPUT     0
+
 // Params for LED matrix width and height
-const uint8_t kMatrixWidth = 10;
-const uint8_t kMatrixHeight = 6;
+const uint16_t kMatrixWidth = 10;
+const uint16_t kMatrixHeight = 6;
 
 #define NUM_LEDS (kMatrixWidth*kMatrixHeight)
 
+// How the panels are chained to make up the matrix.  The bag has a single
+// 10x6 panel wired back and forth from the top left.  For more panels,
+// list them in the order they are chained and set the matrix size to the
+// canvas they cover.
+constexpr PanelTile panels[] = {
+  // x, y, width, height, rotation, mirror, serpentine
+  {  0, 0, 10,    6,      0,        false,  true }
+};
+static_assert(validPixelMap<NUM_LEDS, kMatrixWidth, kMatrixHeight>(panels), "Panels must cover the matrix, each pixel once");
+constexpr PixelMap<NUM_LEDS> pixelMap = makePixelMap<NUM_LEDS, kMatrixWidth>(panels);
+
+// The effects are compiled for a fixed size (see matrixGeometry.h)
+#ifndef MATRIX_RUNTIME_GEOMETRY
+static_assert(MatrixGeometry::width() == kMatrixWidth && MatrixGeometry::height() == kMatrixHeight, "MatrixGeometry doesn't match the matrix size");
+#endif
+
+// Minimum time between rendered frames.  Raise it to save power - effects
+// advance by real elapsed time, so animation speed doesn't change.
+#define FRAME_INTERVAL_MS  10
+
+// How often the LEDs are refreshed with a new dithered version of the current
+// frame.  Needs to be fast enough that the dithering doesn't look like flicker.
+#define DITHER_REFRESH_MS  2
+
+// Most current the LEDs are allowed to draw from the battery.  Brightness
+// is turned down for frames that would go over.
+#define POWER_BUDGET_MA    500
+
+// How long switching between display modes takes
+#define TRANSITION_MS      1000
+
+// Most real time an effect can spend fast-forwarding when it is switched to,
+// so input handling is never held up for long
+#define PREROLL_BUDGET_MS  20
+
 // Use an extra matrix value as a safety pixel so we don't overwrite our 
 //  array boundaries
 CRGB leds_plus_safety_pixel[ NUM_LEDS + 1];
 CRGB* const leds( leds_plus_safety_pixel + 1);
 
-// Buffer for for creating smooth led animations or for scrolling
-CRGB led_buffer_plus_safety_pixel[NUM_LEDS + 1];
-CRGB* const led_buffer(led_buffer_plus_safety_pixel + 1);
+// Layer buffers for the background effects.  There are two so that during
+// a transition the outgoing effect keeps drawing into one while the
+// incoming effect draws into the other.
+CRGB bg_layers_plus_safety_pixel[2][NUM_LEDS + 1];
+#define BG_LAYER(n)   (bg_layers_plus_safety_pixel[n] + 1)
+uint8_t bgSet = 0;   // Layer (and arena slot) the current background effect is using
+
+// The text draws into its own layer, and a transition blends the two 
+// background layers into the mix layer.  The compositor flattens the
+// layers into leds for every frame.
+CRGB text_layer_plus_safety_pixel[NUM_LEDS + 1];
+CRGB* const textLayer(text_layer_plus_safety_pixel + 1);
+CRGB mix_layer_plus_safety_pixel[NUM_LEDS + 1];
+CRGB* const mixLayer(mix_layer_plus_safety_pixel + 1);
+
+// Composited frame, before gamma and white balance are applied on the
+// way out to leds
+CRGB frame[NUM_LEDS];
+
+// 16 bit accumulation buffers for temporal dithering
+uint16_t ditherTarget[NUM_LEDS*3];
+uint8_t  ditherError[NUM_LEDS*3];
+
+// Encoded frames for driving the APA102s directly.  The second one is only
+// used with DMA, where one goes out while the other is filled.
+uint8_t  apa102Frame[2][APA102_FRAME_BYTES(NUM_LEDS)];
+
+// Last frame the power estimate was worked out for
+CRGB powerFrame[NUM_LEDS];
+
+Compositor      compositor(NUM_LEDS);
+LedOutput       ledOutput(leds, NUM_LEDS, pixelMap.index);
+PowerLimiter    powerLimiter(NUM_LEDS, powerFrame, POWER_BUDGET_MA);
+int8_t          bgLayerIndex, textLayerIndex;
+Transition      transition(kMatrixWidth, kMatrixHeight);
+TransitionType  nextTransition = TRANSITION_CROSSFADE;
+
+
+// The text is drawn over every mode, so it is always there
+DrawText        dText(textLayer, kMatrixWidth, kMatrixHeight);
+
+// Display modes, in order.  Only the running mode (and the outgoing one
+// during a transition) exists at a time, built in the arena slot that
+// matches its layer.  Each slot's scratch memory is sized from the modes'
+// scratchBytes().
+EffectArena<2, kMatrixWidth, kMatrixHeight, DisplayRain, Worm, Lines, Twinkle, GameOfLife, BouncingPixels, Fountain>  backgrounds;
+const int numModes = backgrounds.numEffects;
+int displayMode = 0;
 
+// Time the last frame was rendered.  millis() wraps after ~49 days but the
+// unsigned subtraction in loop() still gives the right elapsed time.
+unsigned long lastFrameTime = 0;
+unsigned long lastRefreshTime = 0;
 
-// Class instances
-DrawText        dText(leds, led_buffer, kMatrixWidth, kMatrixHeight);
-DisplayRain     dRain(leds, led_buffer, kMatrixWidth, kMatrixHeight);
-GameOfLife      dGame(leds, led_buffer, kMatrixWidth, kMatrixHeight);
-BouncingPixels  dBounce(leds, led_buffer, kMatrixWidth, kMatrixHeight);
-Twinkle         dTwinkle(leds, led_buffer, kMatrixWidth, kMatrixHeight);
-Lines           dLines(leds, led_buffer, kMatrixWidth, kMatrixHeight);
-Worm            dWorm(leds, led_buffer, kMatrixWidth, kMatrixHeight);
-
-// Display modes
-DisplayMatrix *autoDisplays[] = {&dRain, &dWorm, &dLines, &dTwinkle, &dGame, &dBounce};
-const int numModes = sizeof(autoDisplays)/sizeof(autoDisplays[0]);
-int displayMode = 0;
+// Set by commands that change how the frame looks (mask, gamma, dither)
+// but not the mode, so the next loop() redraws without waiting
+boolean needsRender = false;
 
 // Create Bluefruit object with Hardware Serial (Serial2 on Teensy).  Don't need
 // RTS pin on Bluefruit, but make sure CTS pin is connected to ground
@@ -135,23 +224,101 @@ void setup() {
 
 
   // Set up LED stripts
-  FastLED.addLeds<CHIPSET, DATA_PIN, CLOCK_PIN>(leds, NUM_LEDS).setCorrection(TypicalSMD5050);
-  FastLED.setBrightness( BRIGHTNESS );
+  // Color correction is done by ledOutput's lookup table, so FastLED doesn't need to
+#if !APA102_DIRECT_OUTPUT
+  FastLED.addLeds<CHIPSET, DATA_PIN, CLOCK_PIN>(leds, NUM_LEDS).setCorrection(UncorrectedColor);
+#endif
+  ledOutput.setBrightness( BRIGHTNESS );
+#if APA102_DIRECT_OUTPUT && APA102_DMA_OUTPUT
+  ledOutput.enableApa102Dma(apa102Frame[0], apa102Frame[1]);
+#elif APA102_DIRECT_OUTPUT
+  ledOutput.enableApa102(DATA_PIN, CLOCK_PIN, apa102Frame[0]);
+#else
+  ledOutput.enableDither(ditherTarget, ditherError);
+#endif
   FastLED.clear();
 
+  // Text sits on top of the background, which shows around the letters
+  bgLayerIndex   = compositor.addLayer(BG_LAYER(bgSet), BLEND_REPLACE);
+  textLayerIndex = compositor.addLayer(textLayer, BLEND_ALPHA);
+
+  matrixPalette.begin();
+
   // Initialize random functions
   randomSeed(analogRead(0));
   
   dText.init();
   dText.addStringToBuffer("Hi", 3, 64);
 
-  dRain.init();
-  dGame.init();
-  dBounce.init();
+  DisplayMatrix *first = backgrounds.activate(bgSet, displayMode, BG_LAYER(bgSet), kMatrixWidth, kMatrixHeight);
+  first->scheduler().setFrameInterval(FRAME_INTERVAL_MS);
+  first->init();
+  first->preRoll(PREROLL_BUDGET_MS);
+
+  // Start the frame clock now, so the first frame's dt isn't the whole boot time
+  lastFrameTime = millis();
 }
 
 
 
+//////////////////////////////////////////////////////////////////////
+// Starts the next background effect in the spare set of buffers and
+// arena slot, and transitions to it from the current one.  Whatever was
+// in the spare slot (the outgoing effect of the last switch) goes.  The
+// transition type cycles each time.
+//////////////////////////////////////////////////////////////////////
+void switchMode(int newMode) {
+  if (newMode == displayMode) return;
+  DisplayMatrix *from = backgrounds.get(bgSet);
+
+  bgSet ^= 1;
+  DisplayMatrix *to = backgrounds.activate(bgSet, newMode, BG_LAYER(bgSet), kMatrixWidth, kMatrixHeight);
+  to->scheduler().setFrameInterval(FRAME_INTERVAL_MS);
+  to->clearDisplay();
+  to->init();
+  to->preRoll(PREROLL_BUDGET_MS);
+
+  transition.begin(from, to, nextTransition, TRANSITION_MS);
+  nextTransition = (TransitionType)((nextTransition + 1) % NUM_TRANSITIONS);
+  displayMode = newMode;
+}
+
+#ifdef __DEBUG
+//////////////////////////////////////////////////////////////////////
+// Times SuperCanvas::downsample() at scales 1, 2 and 4 on the real
+// hardware, in memory of its own so nothing that is running is
+// disturbed.  The kernel has no data dependent branches, so a blank
+// canvas times the same as a busy one.
+//////////////////////////////////////////////////////////////////////
+#define BENCH_FRAMES  1000
+
+alignas(4) uint8_t  benchCanvas[NUM_LEDS * 4 * 4 * sizeof(CRGB)];   // Room for the finest scale
+CRGB                benchLeds[NUM_LEDS];
+
+void benchDownsample() {
+  MatrixGeometry geom;
+  geom.set(kMatrixWidth, kMatrixHeight);
+  assert(geom.matches(kMatrixWidth, kMatrixHeight));
+  for (uint8_t scale = 1; scale <= 4; scale <<= 1) {
+    EffectScratch scratch(benchCanvas, sizeof(benchCanvas));
+    scratch.reset();
+    SuperCanvas canvas;
+    canvas.claim(scratch, kMatrixWidth, kMatrixHeight, scale);
+
+    uint32_t start = micros();
+    for (uint16_t n = 0; n < BENCH_FRAMES; n++) {
+      canvas.downsample(benchLeds, geom);
+    }
+    uint32_t took = micros() - start;
+    Serial.print(F("Downsample x"));
+    Serial.print(scale);
+    Serial.print(F(": "));
+    Serial.print((float)took / BENCH_FRAMES);
+    Serial.println(F("us per frame"));
+  }
+}
+#endif
+
 boolean getUartData() {
   boolean gotData = false;
   boolean modeChanged = false;
@@ -169,11 +336,54 @@ boolean getUartData() {
     if (str[0] == '!') {
       str.toLowerCase();
       if (str == "!next") {       // choose next display mode
-        displayMode = (displayMode + 1) % numModes;
+        switchMode((displayMode + 1) % numModes);
         modeChanged = true;
       } else if (str == "!pal") { // Select next palette
-        dText.nextPalette();
-        autoDisplays[displayMode]->nextPalette();
+        matrixPalette.next();
+      } else if (str == "!mask") { // Toggle text cut out of the background
+        dText.setMaskMode(!dText.getMaskMode());
+        needsRender = true;
+      } else if (str == "!gamma") { // Toggle gamma correction
+        ledOutput.setLUT(ledOutput.getLUT() == &smd5050GammaLUT ? &smd5050LinearLUT : &smd5050GammaLUT);
+        needsRender = true;
+      } else if (str == "!dither") { // Toggle temporal dithering
+        if (ledOutput.dithering()) ledOutput.disableDither();
+        else if (!ledOutput.enableDither(ditherTarget, ditherError)) {
+#ifdef __DEBUG
+          Serial.println(F("No dithering with direct APA102 output"));
+#endif
+        }
+        needsRender = true;
+      } else if (str == "!stats") { // Report how often the current mode fell behind
+#ifdef __DEBUG
+        FrameScheduler &sched = backgrounds.get(bgSet)->scheduler();
+        Serial.print(F("Missed deadlines: "));
+        Serial.print(sched.missedDeadlines());
+        Serial.print(F(", skipped steps: "));
+        Serial.println(sched.skippedSteps());
+        Serial.print(F("Output stalls: "));
+        Serial.print(ledOutput.stalls());
+        Serial.print(F(", waited "));
+        Serial.print(ledOutput.stallMicros());
+        Serial.print(F("us, transfer "));
+        Serial.print(LedOutput::transferMicros(APA102_FRAME_BYTES(NUM_LEDS)));
+        Serial.println(F("us per frame"));
+        Serial.print(F("Power: "));
+        Serial.print(powerLimiter.estimatedMA());
+        Serial.print(F("mA of "));
+        Serial.print(powerLimiter.getBudget());
+        Serial.print(F("mA (unlimited "));
+        Serial.print(powerLimiter.unlimitedMA());
+        Serial.print(F("mA), brightness "));
+        Serial.print(powerLimiter.limit());
+        Serial.print(F(", limited frames: "));
+        Serial.println(powerLimiter.limitedFrames());
+        sched.clearStats();
+#endif
+      } else if (str == "!bench") { // Time the supersampling downsample at each scale
+#ifdef __DEBUG
+        benchDownsample();
+#endif
       } 
     } else {
       //dText.init();
@@ -203,15 +413,54 @@ void loop() {
 
   // Check for data from the BLE
   modeChanged = getUartData();  
-  // Update display
-  // if (dataMode == DATA_SOURCE_UART && dText.displayingText()) {
-  if (dText.displayingText()) {
-    dText.update();
-  } else {
-    if (modeChanged) {
-      autoDisplays[displayMode]->clearDisplay();
+
+  // Keep the dithering going between frames
+  unsigned long now = millis();
+  if (ledOutput.dithering() && now - lastRefreshTime >= DITHER_REFRESH_MS) {
+    lastRefreshTime = now;
+    ledOutput.refresh();
+  }
+
+  // Only render once the frame interval has passed
+  uint32_t dt = now - lastFrameTime;
+  if (dt < FRAME_INTERVAL_MS && !modeChanged && !needsRender) return;
+  lastFrameTime = now;
+
+  // Update display.  The background keeps running while text scrolls over it.
+  // During a transition both effects run and get blended into the mix layer
+  boolean changed = modeChanged || needsRender;
+  needsRender = false;
+  if (transition.active()) {
+    if (transition.update(dt)) {
+      transition.render(mixLayer);
+      compositor.setPixels(bgLayerIndex, mixLayer);
+    } else {
+      compositor.setPixels(bgLayerIndex, BG_LAYER(bgSet));
     }
-    autoDisplays[displayMode]->update();
+    changed = true;
+  } else if (backgrounds.get(bgSet)->update(dt)) {
+    changed = true;
+  }
+
+  // Keep any palette switch blending along
+  if (matrixPalette.update(dt)) changed = true;
+
+  // In mask mode the text cuts the background down to its letters
+  // rather than being drawn into its own layer
+  boolean showText = dText.displayingText();
+  boolean drawText = showText && !dText.getMaskMode();
+  boolean maskText = showText && dText.getMaskMode();
+  if (drawText != compositor.isVisible(textLayerIndex) || maskText != compositor.hasMask()) {
+    compositor.setVisible(textLayerIndex, drawText);
+    compositor.setMask(maskText ? &dText : NULL);
+    changed = true;
+  }
+  if (showText && dText.update(dt)) changed = true;
+
+  if (changed) {
+    compositor.render(frame);
+    ledOutput.setBrightness(powerLimiter.update(frame, ledOutput.getLUT(), BRIGHTNESS));
+    ledOutput.show(frame);
   }
 }
 
@@ -0,0 +1,81 @@
+/////////////////////////////////////////////////////
+//  Functions for the layer Compositor
+/////////////////////////////////////////////////////
+
+#include "compositor.h"
+#include "pixelBlend.h"
+
+/////////////////////////////////////////////////////
+// Adds a layer on top of the existing ones.  Returns
+// the layer number, or -1 if there's no room left.
+/////////////////////////////////////////////////////
+int8_t Compositor::addLayer(CRGB *pixels, BlendMode mode, uint8_t opacity) {
+  if (_nLayers >= MAX_COMPOSITOR_LAYERS) return -1;
+  CompositorLayer &layer = _layers[_nLayers];
+  layer.pixels  = pixels;
+  layer.mode    = mode;
+  layer.opacity = opacity;
+  layer.visible = true;
+  return _nLayers++;
+}
+
+/////////////////////////////////////////////////////
+// Combines all visible layers into out.  The bottom
+// layer is blended over black, and the mask (if any)
+// is cut out of the result.
+/////////////////////////////////////////////////////
+void Compositor::render(CRGB *out) {
+  fill_solid(out, _nLeds, CRGB::Black);
+  for (uint8_t i = 0; i < _nLayers; i++) {
+    if (_layers[i].visible && _layers[i].opacity) {
+      blendLayer(_layers[i], out);
+    }
+  }
+  if (_mask) _mask->applyMask(out);
+}
+
+/////////////////////////////////////////////////////
+// Blends one layer into out.  The mode is picked once
+// per layer so each pixel loop is a single kernel.
+/////////////////////////////////////////////////////
+void Compositor::blendLayer(const CompositorLayer &layer, CRGB *out) {
+  const CRGB *src = layer.pixels;
+  uint8_t     opacity = layer.opacity;
+
+  switch (layer.mode) {
+    case BLEND_REPLACE:
+      if (opacity == 255) {
+        memcpy(out, src, _nLeds * sizeof(CRGB));
+      } else {
+        for (uint16_t i = 0; i < _nLeds; i++) {
+          out[i] = unpackRGB(lerpPacked(packRGB(out[i]), packRGB(src[i]), opacity));
+        }
+      }
+      break;
+
+    case BLEND_ADD:
+      for (uint16_t i = 0; i < _nLeds; i++) {
+        uint32_t s = packRGB(src[i]);
+        if (!s) continue;
+        if (opacity != 255) s = scalePacked(s, opacity);
+        out[i] = unpackRGB(addSaturatePacked(packRGB(out[i]), s));
+      }
+      break;
+
+    case BLEND_ALPHA:
+      for (uint16_t i = 0; i < _nLeds; i++) {
+        uint32_t s = packRGB(src[i]);
+        if (!s) continue;
+        out[i] = (opacity == 255) ? src[i] : unpackRGB(lerpPacked(packRGB(out[i]), s, opacity));
+      }
+      break;
+
+    case BLEND_MASK:
+      for (uint16_t i = 0; i < _nLeds; i++) {
+        uint8_t m = max(src[i].r, max(src[i].g, src[i].b));
+        m = 255 - scale8(255 - m, opacity);    // Opacity sets how strongly the mask cuts
+        out[i] = unpackRGB(scalePacked(packRGB(out[i]), m));
+      }
+      break;
+  }
+}
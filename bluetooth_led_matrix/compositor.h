@@ -0,0 +1,62 @@
+#ifndef __COMPOSITOR
+#define __COMPOSITOR
+
+#include <FastLED.h>
+
+///////////////////////////////////////////////////////////////////////
+//  How a layer is combined with the layers below it:
+//    REPLACE - layer covers what is below, faded by the layer opacity
+//    ADD     - layer is added to what is below (saturating)
+//    ALPHA   - like REPLACE, but black pixels in the layer are clear
+//    MASK    - what is below only shows through where the layer is lit,
+//              in proportion to the layer pixel's brightest channel
+///////////////////////////////////////////////////////////////////////
+enum BlendMode { BLEND_REPLACE, BLEND_ADD, BLEND_ALPHA, BLEND_MASK };
+
+struct CompositorLayer {
+  CRGB       *pixels;
+  BlendMode   mode;
+  uint8_t     opacity;
+  boolean     visible;
+};
+
+///////////////////////////////////////////////////////////////////////
+//  Something that can cut the finished frame down to a shape without
+//  first drawing itself into a layer buffer (e.g. scrolling text).
+///////////////////////////////////////////////////////////////////////
+class PixelMask {
+
+public:
+  virtual void applyMask(CRGB *out) = 0;
+};
+
+///////////////////////////////////////////////////////////////////////
+//  Flattens an ordered stack of layers into one frame.  Every effect
+//  draws into its own layer buffer, and the compositor combines them
+//  bottom (first added) to top.
+///////////////////////////////////////////////////////////////////////
+#define MAX_COMPOSITOR_LAYERS 4
+class Compositor {
+
+public:
+  Compositor(uint16_t nLeds) { _nLeds = nLeds; _nLayers = 0; _mask = NULL; };
+  int8_t  addLayer(CRGB *pixels, BlendMode mode = BLEND_REPLACE, uint8_t opacity = 255);
+  void    setPixels(uint8_t layer, CRGB *pixels) { _layers[layer].pixels = pixels; };
+  void    setMode(uint8_t layer, BlendMode mode) { _layers[layer].mode = mode; };
+  void    setOpacity(uint8_t layer, uint8_t opacity) { _layers[layer].opacity = opacity; };
+  void    setVisible(uint8_t layer, boolean visible) { _layers[layer].visible = visible; };
+  boolean isVisible(uint8_t layer) { return _layers[layer].visible; };
+  void    setMask(PixelMask *mask) { _mask = mask; };   // Applied after all layers, NULL for none
+  boolean hasMask() { return _mask != NULL; };
+  void    render(CRGB *out);
+
+private:
+  void    blendLayer(const CompositorLayer &layer, CRGB *out);
+
+  CompositorLayer  _layers[MAX_COMPOSITOR_LAYERS];
+  uint16_t         _nLeds;
+  uint8_t          _nLayers;
+  PixelMask       *_mask;
+};
+
+#endif
@@ -4,43 +4,47 @@
 
 #include "DisplayClass.h"
 #include "sixPixelFont.h"
+#include "pixelBlend.h"
 
 #include <WProgram.h> // Allows calls to Serial.print
 
 /////////////////////////////////////////////////////////
-// Converts 2 dimensional position to LED index.  Copied
-// from FastLED matrix example.  Only works for matrix
-// with serpentine (back and forth) layout
+// Converts 2 dimensional position to LED index, checking
+// it is on the matrix.  XY() itself is the geometry's.
 ////////////////////////////////////////////////////////
-uint16_t DisplayMatrix::XY( uint8_t x, uint8_t y)
+int32_t DisplayMatrix::XYsafe( int32_t x, int32_t y)
 {
-  uint16_t i;
-  
-  if( y & 0x01) {
-    // Odd rows run backwards
-    uint8_t reverseX = ( _width - 1) - x;
-    i = (y *  _width) + reverseX;
-  } else {
-    // Even rows run forwards
-    i = (y *  _width) + x;
-  }
+  if( x < 0 || x >=  _geom.width()) return -1;
+  if( y < 0 || y >=  _geom.height()) return -1;
+  return XY(x,y);
+}
 
-  return i;
+/////////////////////////////////////////////////////////
+// Pixel i along a path that runs back and forth across
+// the rows, whatever order the canvas is in
+////////////////////////////////////////////////////////
+uint16_t DisplayMatrix::snakeXY(uint16_t i) {
+  MatrixCoord y = i / _geom.width();
+  MatrixCoord x = i % _geom.width();
+  return XY((y & 0x01) ? _geom.width() - 1 - x : x, y);
 }
 
-uint16_t DisplayMatrix::XYsafe( uint8_t x, uint8_t y)
-{
-  if( x >=  _width) return -1;
-  if( y >=  _height) return -1;
-  return XY(x,y);
+/////////////////////////////////////////////////////////////////////
+// Moves the scroll position on by dtMS milliseconds worth of columns.
+// Keeps the remainder so slow speeds and short frames don't lose time.
+/////////////////////////////////////////////////////////////////////
+void SubPixelScroller::advance(uint32_t dtMS) {
+  uint32_t delta = (uint32_t)_speed * 256 * dtMS + _remainder;
+  _pos += delta / 1000;
+  _remainder = delta % 1000;
 }
 
 ////////////////////////////////////
 // Shifts all rows down by one
 ////////////////////////////////////
 void DisplayMatrix::shiftOneDown(CRGB *leds) {
-  for (byte y = _height-1; y > 0; y--) {
-    for (byte x = 0; x < _width; x++) {
+  for (MatrixCoord y = _geom.height()-1; y > 0; y--) {
+    for (MatrixCoord x = 0; x < _geom.width(); x++) {
       leds[ XY(x, y)] = leds[ XY(x, y-1)];
     }
   }
@@ -49,8 +53,8 @@ void DisplayMatrix::shiftOneDown(CRGB *leds) {
 // Shifts all rows up by one
 ////////////////////////////////////
 void DisplayMatrix::shiftOneUp(CRGB *leds) {
-  for (byte y = 0; y < _height; y++) {
-    for (byte x = 0; x < _width; x++) {
+  for (MatrixCoord y = 0; y < _geom.height(); y++) {
+    for (MatrixCoord x = 0; x < _geom.width(); x++) {
       leds[ XY(x,y)] = leds[ XY(x, y+1)];
     }
   }
@@ -60,8 +64,8 @@ void DisplayMatrix::shiftOneUp(CRGB *leds) {
 // Shifts all columns right by one
 /////////////////////////////////////
 void DisplayMatrix::shiftOneRight(CRGB *leds) {
-  for (byte x = _width-1; x > 0; x--) {
-    for (byte y = 0; y < _height; y++) {
+  for (MatrixCoord x = _geom.width()-1; x > 0; x--) {
+    for (MatrixCoord y = 0; y < _geom.height(); y++) {
       leds[ XY(x,y)] = leds[ XY(x-1,y)];  
     }
   } 
@@ -71,89 +75,101 @@ void DisplayMatrix::shiftOneRight(CRGB *leds) {
 // Shifts all columns left by one
 /////////////////////////////////////
 void DisplayMatrix::shiftOneLeft(CRGB *leds) {
-  for (byte x = 0; x < _width-1; x++){
-    for (byte y = 0; y < _height; y++) {
+  for (MatrixCoord x = 0; x < _geom.width()-1; x++){
+    for (MatrixCoord y = 0; y < _geom.height(); y++) {
       leds[ XY(x,y)] = leds[ XY(x+1, y)];
     }
   }
 }
 
 ///////////////////////////////////////////////////////////////////////
-// Returns weighted interpolation of color that falls percent % 
-//  between colors p1 and p2
+// Helper function to copy led configuration between two arrays
 ///////////////////////////////////////////////////////////////////////
-CRGB weightPixels(CRGB p1, CRGB p2, uint8_t percent, boolean cubic=false) {
-  fract8 f = 255*percent/100;
-  if (cubic) f = ease8InOutCubic(f);
-  return CRGB(lerp8by8(p2.r, p1.r, f), lerp8by8(p2.g, p1.g, f), lerp8by8(p2.b, p1.b, f));
-}
-
-
-/////////////////////////////////////////////////////////////////////////////////////////////////////
-// Shifts all rows down by a specified percentage.  Will split the light percentage wise between two 
-// pixels.  Assumes the buffer holds the current  matrix and that the display leds get interpolated
-// values.
-////////////////////////////////////////////////////////////////////////////////////////////////////
-void DisplayMatrix::shiftPercentDown(int percent, CRGB *nextRow) {
-  
-  // All rows but the first
-  for (int y = 1; y < _height; y++) {
-    for (int x = 0; x < _width; x++) {
-      _leds[XY(x,y)] = weightPixels(_buffer[XY(x,y-1)], _buffer[XY(x,y)], percent, true);
-    }
+void DisplayMatrix::copyMatrix(CRGB *from, CRGB *to, uint16_t nleds) {
+  for (int i = 0; i < nleds; i++) {
+    to[i] = from[i];
   }
-  // Special case for first row
-  for (int x = 0; x < _width; x++) {
-     _leds[XY(x,0)] = weightPixels(nextRow[x], _buffer[XY(x,0)], percent, true);
-  }  
 }
 
-void DisplayMatrix::shiftPercentLeft(int percent, CRGB *nextCol) {
-
-  // All columns but last
-  for (int x = 0; x < _width-1; x++) {
-    for (int y = 0; y < _height; y++) {
-      _leds[XY(x,y)] = weightPixels(_buffer[XY(x+1,y)], _buffer[XY(x,y)], percent, true);
+/////////////////////////////////////////////////////////////////////////////
+// Draws columns of a one bit per pixel bitmap (top row in bit height-1) so
+// that screen column x shows bitmap column firstCol + x, shifted left by
+// fraction/256 of a column.  Columns outside the bitmap are blank. Each
+// pixel is lit by its column, the next column, or both, so the four
+// possible colors are worked out once per frame.
+/////////////////////////////////////////////////////////////////////////////
+void DisplayMatrix::drawScrolledColumns(const uint8_t *cols, int16_t firstCol, uint16_t nCols, fract8 fraction, CRGB color) {
+  CRGB shades[4];
+  shades[0] = CRGB::Black;                                      // Neither column lit
+  shades[1] = unpackRGB(scalePacked(packRGB(color), fraction));        // Next column only
+  shades[2] = unpackRGB(scalePacked(packRGB(color), 255 - fraction));  // This column only
+  shades[3] = color;                                            // Both
+
+  uint8_t cur = (firstCol >= 0 && firstCol < (int16_t)nCols) ? cols[firstCol] : 0;
+  for (MatrixCoord x = 0; x < _geom.width(); x++) {
+    int16_t  c = firstCol + x + 1;
+    uint8_t  next = (c >= 0 && c < (int16_t)nCols) ? cols[c] : 0;
+    uint8_t  mask = 0x01 << (min(_geom.height(), (uint16_t)8) - 1);   // Columns are 8 bits, any rows below are blank
+    for (MatrixCoord y = 0; y < _geom.height(); y++) {
+      uint8_t shade = ((cur & mask) ? 2 : 0) | ((next & mask) ? 1 : 0);
+      _leds[XY(x, y)] = shades[shade];
+      mask >>= 1;
     }
-  }
-  // Special case for last column
-  for (int y = 0; y < _height; y++) {
-    _leds[XY(_width-1, y)] = weightPixels(nextCol[y], _buffer[XY(_width-1,y)], percent, true);
-  }
-}
-
-///////////////////////////////////////////////////////////////////////
-// Helper function to copy led configuration between two arrays
-///////////////////////////////////////////////////////////////////////
-void DisplayMatrix::copyMatrix(CRGB *from, CRGB *to, uint8_t nleds) {
-  for (int i = 0; i < nleds; i++) {
-    to[i] = from[i];
+    cur = next;
   }
 }
 
 //////////////////////////////////////////////////
-// Sets all pixels to off (black)
+// Sets all pixels to off (black).  Shows up on the
+// LEDs the next time the layers are composited.
 //////////////////////////////////////////////////
 void DisplayMatrix::clearDisplay() {
-  int nLeds = _width*_height;
+  int nLeds = _geom.nLeds();
   for (int i = 0; i < nLeds; i++) {
     _leds[i] = CRGB::Black;
   }
-  FastLED.show();
 }
 
 /////////////////////////////////////////////////
-// Returns true if time to update display.  In-
-// crements _lastUpdateTime if so.
+// Fast-forwards the effect by preRollMS() on a
+// virtual clock, one scheduler step per update, so
+// it looks settled as soon as it is shown.  Stops
+// early if it has used budgetMS of real time.
+/////////////////////////////////////////////////
+void DisplayMatrix::preRoll(uint16_t budgetMS) {
+  uint32_t      simMS  = preRollMS();
+  uint16_t      tickMS = max(_scheduler.getStep(), (uint16_t)1);
+  unsigned long start  = millis();
+
+  for (uint32_t t = 0; t < simMS; t += tickMS) {
+    update(tickMS);
+    if (millis() - start >= budgetMS) break;
+  }
+  _scheduler.clearStats();   // Don't count the pre-roll as falling behind
+}
+
+/////////////////////////////////////////////////
+// Adds dtMS of elapsed time and returns the number
+// of whole steps now due (0 if it isn't time yet).
+// The first call after a reset always runs a step.
 /////////////////////////////////////////////////
-boolean DisplayMatrix::timeToUpdate() {
-  long curTime = millis();
-  if ((_lastUpdateTime < 0) || (curTime - _lastUpdateTime > _delayMS)) {
-    _lastUpdateTime = curTime;
+uint8_t FrameScheduler::advance(uint32_t dtMS) {
+  _accumulator += dtMS;
+  if (_accumulator < _stepMS) return 0;
+
+  // A step shorter than the frame interval is due several times every
+  // frame, which is only a miss if even more than that are due
+  uint32_t steps = _accumulator / _stepMS;
+  uint32_t expected = max((_frameMS + _stepMS - 1) / _stepMS, 1);
+  if (steps > expected) _missed++;
+  if (steps > _maxSteps) {                 // Too far behind - drop the extra time
+    _skipped += steps - _maxSteps;
+    steps = _maxSteps;
+    _accumulator %= _stepMS;
   } else {
-    return false;
-  } 
-  return true;
+    _accumulator -= steps * _stepMS;
+  }
+  return steps;
 }
 
 /////////////////////////////////////////////////
@@ -161,51 +177,58 @@ boolean DisplayMatrix::timeToUpdate() {
 /////////////////////////////////////////////////
 void DrawText::init() {
   setDisplayText("");
-  _lastUpdateTime = -1;
-  _colPtr = 0;
+  _scheduler.reset();
+  _scroller.reset();
 }
 
 //////////////////////////////////////////////////////////////////////////
-// Update: Scroll text left, and fill in next column from the text buffer.
+// Update: Advance the scroll position by the time since the last frame
+// and redraw the visible columns, blending between neighboring columns
+// for the fractional part of the position.
 //////////////////////////////////////////////////////////////////////////
-boolean DrawText::update() {
-
-  if (!timeToUpdate()) return false;
+boolean DrawText::update(uint32_t dtMS) {
 
-  // Shift text one left
-  shiftOneLeft(_buffer);
+  _scroller.advance(min(dtMS, MAX_UPDATE_DT_MS));
 
-  // Fill in rightmost row from the display buffer
-  byte mask = B00100000;
-  if (_colPtr < _colLen) {
-    for (int y = 0; y < _height; y++) {
-      _buffer[XY(_width-1,y)] = (_displayBuffer[_colPtr] & mask) ? _color : CRGB::Black;
-      mask >>=1;
-    }
-    _colPtr++;
-  } else if (_colPtr - _colLen >= _width) {  // Done scrolling - reset [TBD - GET NEXT STRING]
+  // Text starts just off the right edge, and is done once it has
+  // scrolled all the way off the left edge
+  if (_scroller.column() >= _colLen + _geom.width()) {
     _textInBuffer = false;
     if (!_stringBuffer.isEmpty()) {
       char      txt[MAX_STRING_LENGTH];
       uint8_t   colorIndex;
       _stringBuffer.popFirst(txt, &colorIndex);
-      _color = ColorFromPalette( getPalette(), colorIndex, 64, LINEARBLEND);
+      _color = paletteColor(colorIndex, 64);
       setDisplayText(txt);
-      _colPtr = 0;
     } 
-  } else {                                   // Text is finished, but keep scrolling till it is off the screen
-    for (int y = 0; y < _height; y++) {
-      _buffer[XY(_width-1,y)] = CRGB::Black;
-    }
-    _colPtr++;
   }
   
-  copyMatrix(_buffer, _leds, _width*_height);
-  FastLED.show();
+  // In mask mode nothing is drawn - applyMask() reads the columns directly
+  if (!_maskMode) {
+    drawScrolledColumns(_displayBuffer, (int16_t)_scroller.column() - _geom.width(), _colLen, _scroller.fraction(), _color);
+  }
 
   return true;
 }
 
+//////////////////////////////////////////////////////////////////////////
+// Blacks out every pixel of out that isn't part of a letter, straight
+// from the packed text columns.  The scroll position is rounded to the
+// nearest whole column so each pixel is just one bit test.
+//////////////////////////////////////////////////////////////////////////
+void DrawText::applyMask(CRGB *out) {
+  int16_t firstCol = (int16_t)_scroller.column() - _geom.width() + (_scroller.fraction() >> 7);
+  for (MatrixCoord x = 0; x < _geom.width(); x++) {
+    int16_t c = firstCol + x;
+    uint8_t bits = (c >= 0 && c < (int16_t)_colLen) ? _displayBuffer[c] : 0;
+    uint8_t mask = 0x01 << (min(_geom.height(), (uint16_t)8) - 1);
+    for (MatrixCoord y = 0; y < _geom.height(); y++) {
+      if (!(bits & mask)) out[XY(x, y)] = CRGB::Black;
+      mask >>= 1;
+    }
+  }
+}
+
 //////////////////////////////////////////////////////
 //  Writes text pixels to the text buffer
 //////////////////////////////////////////////////////
@@ -252,56 +275,8 @@ void DrawText::setDisplayText(const char *txt) {
     }
     _textInBuffer = true;
   }
-  // Reset the column pointer
-  _colPtr = 0;
-}
-
-
-/////////////////////////////////////////////////////////////////////////
-// Selects next color (in steps of 3) from the palette
-////////////////////////////////////////////////////////////////////////
-CRGB DisplayRain::nextColorFromPalette() {
-  _colorIndex = (_colorIndex + 3) % 256;
-  return ColorFromPalette( getPalette(), _colorIndex, _brightness, _blending);
-}
-
-
-//////////////////////////////////////////////////////////////
-// Initialization
-//////////////////////////////////////////////////////////////
-void DisplayRain::init() {
-  _lastUpdateTime = -1;
-  _paletteIndex = 0;
-  _blending = LINEARBLEND;
-  _counter = 0;
-}
-
-
-//////////////////////////////////////////////////////////////
-// Update:  Moves raindrops down and creates new ones
-//////////////////////////////////////////////////////////////
-boolean DisplayRain::update() {
-  static CRGB firstRow[16];
-
-  if (!timeToUpdate()) return false;
- 
-  if (_counter == 0) {  // Load up a new first row and move the buffer pixels down by one
-
-    shiftOneDown(_buffer);
-    for (int x = 0; x < _width; x++) {
-      _buffer[XY(x, 0)] = firstRow[x];
-    }
-    
-    for (int x = 0; x < _width; x++) {   // Generate a new top row
-      firstRow[x] = (random(10) < 1) ? nextColorFromPalette() : CRGB::Black; 
-    }   
-  }
-  
-  shiftPercentDown(_counter, firstRow);
-  FastLED.show();
-
-  _counter = (_counter + 1) % 100;
-  return true;
+  // Start scrolling from the beginning
+  _scroller.reset();
 }
 
 
@@ -309,160 +284,200 @@ boolean DisplayRain::update() {
 // Init function - reset variables
 ////////////////////////////////////////////
 void GameOfLife::init() {
-  _paletteIndex = 0;
-  _lastUpdateTime = -1;
+  _scheduler.reset();
 }
 
 /////////////////////////////////////////////////////////////////////////////
 // Copies the pixels for the next generation from the buffer to the LEDs
 ////////////////////////////////////////////////////////////////////////////
 void GameOfLife::setDisplayPixels(int ptr) {
-  int nPixels = _width*_height;
+  int nPixels = _geom.nLeds();
   for (int i = 0; i < nPixels; i++) {
-    _leds[i] = _buffer[i][ptr] ? ColorFromPalette( getPalette(), _buffer[i][ptr], _brightness, _blending) : CRGB::Black;
+    _leds[i] = _cells[ptr][i] ? paletteColor(_cells[ptr][i], _brightness) : CRGB::Black;
   }
 }
 
 //////////////////////////////////////////////////////////////////////////
 //  Returns the number of living neighbors for the pixel at (x,y).  Ptr
-//   determines whether we use the values in the red or green channel
-//   for this particular generation.  Remember pixel (0,0) is top left.
+//   determines which generation's plane is used.  Remember pixel (0,0) is top left.
 //////////////////////////////////////////////////////////////////////////
 int GameOfLife::countNeighbors(int ptr, int x, int y) {
   
-  int left  = (x == 0) ? _width - 1 : x - 1;
-  int right = (x == (_width - 1)) ? 0 : x + 1;
-  int bottom   = (y == (_height - 1)) ? 0 : y + 1;
-  int top = (y == 0) ? _height - 1 : y - 1;
+  int left  = (x == 0) ? _geom.width() - 1 : x - 1;
+  int right = (x == (_geom.width() - 1)) ? 0 : x + 1;
+  int bottom   = (y == (_geom.height() - 1)) ? 0 : y + 1;
+  int top = (y == 0) ? _geom.height() - 1 : y - 1;
   
-  int topLeft      = _buffer[XY(left, top)][ptr] ? 1 : 0;
-  int topMiddle    = _buffer[XY(x, top)][ptr] ? 1 : 0;
-  int topRight     = _buffer[XY(right, top)][ptr] ? 1 : 0;
-  int middleLeft   = _buffer[XY(left, y)][ptr] ? 1 : 0;
-  int middleRight  = _buffer[XY(right, y)][ptr] ?  1: 0;
-  int bottomLeft   = _buffer[XY(left, bottom)][ptr] ? 1 : 0;
-  int bottomMiddle = _buffer[XY(x, bottom)][ptr] ? 1 : 0;
-  int bottomRight  = _buffer[XY(right, bottom)][ptr] ? 1 : 0;
+  int topLeft      = _cells[ptr][XY(left, top)] ? 1 : 0;
+  int topMiddle    = _cells[ptr][XY(x, top)] ? 1 : 0;
+  int topRight     = _cells[ptr][XY(right, top)] ? 1 : 0;
+  int middleLeft   = _cells[ptr][XY(left, y)] ? 1 : 0;
+  int middleRight  = _cells[ptr][XY(right, y)] ?  1: 0;
+  int bottomLeft   = _cells[ptr][XY(left, bottom)] ? 1 : 0;
+  int bottomMiddle = _cells[ptr][XY(x, bottom)] ? 1 : 0;
+  int bottomRight  = _cells[ptr][XY(right, bottom)] ? 1 : 0;
 
   return (topLeft + topMiddle + topRight + middleLeft + middleRight + bottomLeft + bottomMiddle + bottomRight);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////
-// Use the Red and Green channels (0 and 1 respectively) of the buffer to 
-// store the current and next generation values of each pixel
+// The two cell planes hold the current and next generation values of
+// each pixel, and swap roles every step.  Returns false
+// if everything died, in which case the next step starts a new board.
 /////////////////////////////////////////////////////////////////////////////////////
-boolean GameOfLife::update() {
-
-  if (!timeToUpdate()) return false;
+boolean GameOfLife::step() {
 
   int from = _counter % 2;
   int to = from ? 0 : 1;
 
   if (_counter == 0) {                            // Re-initialize the matrix with randomly
-    int nLeds = _width*_height;                   // placed pixels
+    int nLeds = _geom.nLeds();                   // placed pixels
     for (int i = 0; i < nLeds; i++) {
-      _buffer[i][to] = (random(4) < 1) ? 1 : 0;
+      _cells[to][i] = (random(4) < 1) ? 1 : 0;
     }
   } else {
     boolean allDead = true;
-    for (int x = 0; x < _width; x++) {
-      for (int y = 0; y < _height; y++) {
-        int index = XYsafe(x,y);
+    for (int x = 0; x < _geom.width(); x++) {
+      for (int y = 0; y < _geom.height(); y++) {
+        int index = XY(x,y);
         int neighbors = countNeighbors(from,x,y);
-        if (_buffer[index][from] == 0) {                // Cell currently dead
-          if (neighbors == 3) _buffer[index][to] = 1;   // Comes to life with 3 neighbors
-          else _buffer[index][to] = 0;
+        if (_cells[from][index] == 0) {                 // Cell currently dead
+          if (neighbors == 3) _cells[to][index] = 1;    // Comes to life with 3 neighbors
+          else _cells[to][index] = 0;
         } else {
           allDead = false;
-          if (neighbors < 2) _buffer[index][to] = 0;    // Too few neighbors, dies of lonliness
-          else if (neighbors <= 3) _buffer[index][to] = _buffer[index][from] + 1;
-          else _buffer[index][to] = 0;                  // Too many neighbors, dies of overcrowding
+          if (neighbors < 2) _cells[to][index] = 0;     // Too few neighbors, dies of lonliness
+          else if (neighbors <= 3) _cells[to][index] = _cells[from][index] + 1;
+          else _cells[to][index] = 0;                   // Too many neighbors, dies of overcrowding
         }
       }
     }
     if (allDead) {
       _counter = 0;
-      return true;
+      return false;
     }
   }
-  setDisplayPixels(to);
-  FastLED.show();
+  _showPtr = to;
   _counter = (_counter + 1)% 254;  // Don't want _counter to get to 255, because we access _counter+1
   return true;
 }
 
+/////////////////////////////////////////////////////////////////////////////////////
+// Runs the generations that are due and shows the newest one
+/////////////////////////////////////////////////////////////////////////////////////
+boolean GameOfLife::update(uint32_t dtMS) {
+
+  if (!_cells[1]) return false;
+  uint8_t steps = stepsDue(dtMS);
+  if (!steps) return false;
+
+  boolean changed = false;
+  while (steps--) {
+    if (step()) changed = true;
+  }
+  if (!changed) return false;
+
+  setDisplayPixels(_showPtr);
+  return true;
+}
+
 ///////////////////////////////////////////////////////////////
-// Initialization: give each pixel an a position and velocity
+// Runs the particles one step at a time and redraws them
 ///////////////////////////////////////////////////////////////
-void BouncingPixels::init() {
-  // Assign each pixel anm initial position and a velocity
-  for (int i = 0; i < N_BOUNCING_PIXELS; i++) {
-     _pos[i][0] = random(100*_width)/100.0;
-     _pos[i][1] = random(100*_height)/100.0;
-     _vel[i][0] = (random(400) + 200.0)/100.0;
-     _vel[i][1] = (random(400) + 200.0)/100.0;
-    // _col[i] = floor(i*255/N_BOUNCING_PIXELS);
-    _col[i] = constrain(i*10, 0, 255);
+boolean ParticleEffect::update(uint32_t dtMS) {
+  uint8_t steps = stepsDue(dtMS);
+  if (!steps) return false;
+
+  while (steps--) {
+    spawn(_scheduler.getStep());
+    _particles.update(_scheduler.getStep());
   }
-  _lastUpdateTime = -1;
+  fill_solid(_leds, _geom.nLeds(), CRGB::Black);
+  _renderer->render(_particles, _leds);
+  return true;
 }
 
 ///////////////////////////////////////////////////////////////
-// Move each pixel and redraw display
+// Drops keep their speed and are gone once off the matrix
 ///////////////////////////////////////////////////////////////
-boolean BouncingPixels::update() {
+const ParticleParams DisplayRain::physics = { 0, 0, WALLS_KILL, 0, 0 };
 
-  //Serial.print("in Update");
-  if (!timeToUpdate()) return false;
-  
-  uint16_t dt = _delayMS;
-  // Calculate current position for each pixel
-  for (int i = 0; i < N_BOUNCING_PIXELS; i++) {
-    float xpos = _pos[i][0] + _vel[i][0]*dt/1000;
-    if (xpos < 0) {
-      xpos = abs(xpos);
-      _vel[i][0] = -1*_vel[i][0];
-    }
-    if (xpos >= _width) {
-      xpos = 2*_width - xpos;
-      _vel[i][0] = -1*_vel[i][0];
-    }
-    float ypos = _pos[i][1] + _vel[i][1]*dt/1000;
-    if (ypos < 0) {
-      ypos = abs(ypos);
-      _vel[i][1] = -1*_vel[i][1];
-    }
-    if (ypos >= _height) {
-      ypos = 2*_height - ypos;
-      _vel[i][1] = -1*_vel[i][1];
-    }
-    _pos[i][0] = xpos;
-    _pos[i][1] = ypos;    
-
-/*
-    Serial.print("xpos = ");
-    Serial.print(xpos);
-    Serial.print("ypos = ");
-    Serial.println(ypos);
-*/ 
+///////////////////////////////////////////////////////////////
+// Initialization: drops start a row above the top, falling
+// between 6 and 16 rows per second, each 3 palette steps on
+// from the last
+///////////////////////////////////////////////////////////////
+void DisplayRain::init() {
+  ParticleEffect::init();
+  _cloud.x = 0;
+  _cloud.y = -(SPLAT_ONE - 1);    // Just touching the top row, so it slides in
+  _cloud.vx = 0;
+  _cloud.vy = 2800;
+  _cloud.spreadX = 0;
+  _cloud.spreadY = 1200;
+  _cloud.ratePerSec = 0;
+  _cloud.lifeMS = 0;
+  _cloud.colorIndex = 0;
+  _cloud.colorStep = 3;
+  fill_solid(_leds, _geom.nLeds(), CRGB::Black);
+}
+
+///////////////////////////////////////////////////////////////
+// Each column starts about one drop per second
+///////////////////////////////////////////////////////////////
+void DisplayRain::spawn(uint16_t stepMS) {
+  for (MatrixCoord x = 0; x < _geom.width(); x++) {
+    if ((uint32_t)random(1000) >= stepMS) continue;
+    _cloud.x = (int32_t)x << SPLAT_SHIFT;
+    if (_particles.emit(_cloud) < 0) break;
+    _cloud.colorIndex += _cloud.colorStep;
   }
+}
 
-  // Draw pixels into buffer
-  // First clear buffer
-  fill_solid(_leds, _width*_height, CRGB::Black);
+///////////////////////////////////////////////////////////////
+// No gravity, walls keep all the speed, colors move a
+// palette step every 50ms
+///////////////////////////////////////////////////////////////
+const ParticleParams BouncingPixels::physics = { 0, 0, WALLS_BOUNCE, 255, 20 };
 
-  // Calculate how far from the four surrounding pixels the "ball" is, and adjust brightness accordingly
-  // If pixels intersect, last one overwrites the previous ones (currently) - should try to blend colors, probably
+///////////////////////////////////////////////////////////////
+// Initialization: give each pixel an a position and velocity
+///////////////////////////////////////////////////////////////
+void BouncingPixels::init() {
+  ParticleEffect::init();
+  // Assign each pixel an initial position and a velocity of 2 - 6 pixels/sec
   for (int i = 0; i < N_BOUNCING_PIXELS; i++) {
-    int x = floor(_pos[i][0]);
-    int y = floor(_pos[i][1]);
-
-    _leds[XY(x,y)] = ColorFromPalette(getPalette(), _col[i], 100, _blending);
-    _col[i] = (_col[i] + 1) % 255; // Let colors evolve
-    
+    ParticleEmitter start = { (int32_t)random(_geom.width() << SPLAT_SHIFT), (int32_t)random(_geom.height() << SPLAT_SHIFT),
+                              (int16_t)random(2*SPLAT_ONE, 6*SPLAT_ONE), (int16_t)random(2*SPLAT_ONE, 6*SPLAT_ONE), 0, 0,
+                              0, 0, (uint8_t)constrain(i*10, 0, 255), 0 };
+    _particles.emit(start);
   }
-  FastLED.show();
-  return true;
+}
+
+///////////////////////////////////////////////////////////////
+// 12 pixels/sec/sec of gravity, particles that leave the
+// matrix are gone
+///////////////////////////////////////////////////////////////
+const ParticleParams Fountain::physics = { 0, 12*SPLAT_ONE, WALLS_KILL, 0, 0 };
+
+///////////////////////////////////////////////////////////////
+// Initialization: put the spout at the bottom middle, fast
+// enough to just reach the top row
+///////////////////////////////////////////////////////////////
+void Fountain::init() {
+  int32_t maxY = (int32_t)(_geom.height() - 1) << SPLAT_SHIFT;
+  _spout.x = (int32_t)(_geom.width() - 1) << (SPLAT_SHIFT - 1);
+  _spout.y = maxY;
+  _spout.vx = 0;
+  _spout.vy = -min(sqrt(2.0 * physics.gravityY * maxY), (double)PARTICLE_MAX_SPEED);
+  _spout.spreadX = 3*SPLAT_ONE/2;
+  _spout.spreadY = -_spout.vy / 8;
+  _spout.ratePerSec = 16;
+  _spout.lifeMS = 2000;
+  _spout.colorIndex = 0;
+  _spout.colorStep = 8;
+  _particles.setEmitters(&_spout, 1);
+  ParticleEffect::init();
 }
 
 ///////////////////////////////////////////////////////////////
@@ -470,42 +485,56 @@ boolean BouncingPixels::update() {
 ///////////////////////////////////////////////////////////////
 void Twinkle::init() {
   // Reset all pixels in init
-  _lastUpdateTime = -1;
-  fill_solid(_leds, _width*_height, CRGB::Black);
-  fill_solid(_buffer, _width*_height, CRGB::Black);
+  _scheduler.reset();
+  fill_solid(_leds, _geom.nLeds(), CRGB::Black);
+  if (_lit) memset(_lit, 0, (_geom.nLeds() + 7) / 8);
 }
 
 ///////////////////////////////////////////////////////////////
-// H, V values stored in _buffer, TBD - explain algorithm
+// One lit flag, hue and age per pixel
 ///////////////////////////////////////////////////////////////
-boolean Twinkle::update() {
- if (!timeToUpdate()) return false;
-  
-// Chance of pixel getting turned on = pct/(pixel lifetime)
-  for (int x = 0; x < _width; x++) {
-    for (int y = 0; y < _height; y++) {
-      uint16_t index = XY(x,y);
-      if (isLit(index)) {
-        // Increment or decrement light here
-        uint8_t brightval = _buffer[index][2];
-        if (brightval == 255) {
-          _buffer[index] = CRGB::Black;  // Buffer is done
-          _leds[index] = CRGB::Black;
-        }
-        else {
-          brightval = sin8(brightval/2);
-          _leds[index] = CHSV(_buffer[index][0], brightval, brightval);
-          _buffer[index][2]++;
+boolean Twinkle::claimScratch(EffectScratch &scratch) {
+  uint16_t nPixels = _geom.nLeds();
+  _lit = scratch.bitPlane(nPixels);
+  _hue = scratch.bytePlane(nPixels);
+  _age = scratch.bytePlane(nPixels);
+  return _lit && _hue && _age;
+}
+
+///////////////////////////////////////////////////////////////
+// A lit pixel fades up and back down with its age, then goes
+// out.  Each step any dark pixel may start a new twinkle.
+///////////////////////////////////////////////////////////////
+boolean Twinkle::update(uint32_t dtMS) {
+  if (!_age) return false;
+  uint8_t steps = stepsDue(dtMS);
+  if (!steps) return false;
+
+  while (steps--) {
+    // Chance of pixel getting turned on = pct/(pixel lifetime)
+    for (int x = 0; x < _geom.width(); x++) {
+      for (int y = 0; y < _geom.height(); y++) {
+        uint16_t index = XY(x,y);
+        if (isLit(index)) {
+          // Increment or decrement light here
+          uint8_t brightval = _age[index];
+          if (brightval == 255) {
+            clearBit(_lit, index);  // Twinkle is done
+            _leds[index] = CRGB::Black;
+          }
+          else {
+            brightval = sin8(brightval/2);
+            _leds[index] = CHSV(_hue[index], brightval, brightval);
+            _age[index]++;
+          }
+        } else if (random(_oddsFilled) == 1) {  // Create new lit pixel
+          setBit(_lit, index);
+          _hue[index] = random(255); // Use Hue and Brigthness.  Set saturation = brightness for now.
+          _age[index] = 0;
         }
-      } else if (random(_oddsFilled) == 1) {  // Create new lit pixel
-        _buffer[index][0]= random(255); // Use Hue and Brigthness.  Set saturation = brightness for now.
-        _buffer[index][2] = 0;
       }
     }
   }
-  // Now copy buff to led matrix and show it
-  
-  FastLED.show();
   return true;
 }
 
@@ -516,95 +545,93 @@ void Worm::init() {
   _front = _length; 
   _dir = 1;
   _colorIndex = 0;
-  _lastUpdateTime = -1;
+  _scheduler.reset();
 }
 
 ///////////////////////////////////////////////////////////////
 // 
 ///////////////////////////////////////////////////////////////
-boolean Worm::update() {
+boolean Worm::update(uint32_t dtMS) {
 
-  if (!timeToUpdate()) return false;
-  
-  uint8_t middle = _front - (_length +1)/2;
-  for (int i = _front - _length; i < _front; i++) {
-    uint8_t bright = (128 - abs(middle - i)*16) % 255;  // Make middle brightest
-    _leds[i] = ColorFromPalette(getPalette(), (i*4) % 255, bright, _blending);
-  }
-  FastLED.show();
+  uint8_t steps = stepsDue(dtMS);
+  if (!steps) return false;
 
-  // Now color them all black to be redrawn for next time
-  for (int i = _front - _length; i < _front; i++) {
-    _leds[i] = CRGB::Black;
+  // Erase the worm where it was last drawn
+  for (Position i = _front - _length; i < _front; i++) {
+    _leds[snakeXY(i)] = CRGB::Black;
   }
 
   // Move the worm in the correct direction.  Turn around at the ends
-  _front += _dir;
-  if (_front > _width*_height) {
-    _front = _width*_height;
-    _dir *= -1;
-  } else if (_front < _length) {
-    _front = _length;
-    _dir *= -1;
+  while (steps--) {
+    _front += _dir;
+    if (_front > _geom.nLeds()) {
+      _front = _geom.nLeds();
+      _dir *= -1;
+    } else if (_front < _length) {
+      _front = _length;
+      _dir *= -1;
+    }
+  }
+  
+  Position middle = _front - (_length +1)/2;
+  for (Position i = _front - _length; i < _front; i++) {
+    uint8_t bright = (128 - abs(middle - i)*16) % 255;  // Make middle brightest
+    _leds[snakeXY(i)] = paletteColor((i*4) % 255, bright);
   }
   
   return true;
 }
 
 ///////////////////////////////////////////////////////////////
-// Lines class initialization
+// Lines class initialization.  The lines move a subpixel at a time, so one step is a
+// fraction of the time to cross an LED
 ///////////////////////////////////////////////////////////////
+boolean Lines::claimScratch(EffectScratch &scratch) {
+  if (!_canvas.claim(scratch, _geom.width(), _geom.height())) return false;
+  _scheduler.setStep(max(_moveMS >> _canvas.shift(), 1));
+  return true;
+}
+
 void Lines::init() {
    _rowColorIndex = 1;
    _colColorIndex = 1; 
    _currentRow = 0; 
    _currentCol = 0; 
-   _rowIncrement = 1; 
-   _colIncrement = 1;
+   _rowIncrement = -1;   // Flipped at the edge before the first move
+   _colIncrement = -1;
 }
 
 ///////////////////////////////////////////////////////////////
 // Draws moving horz/vert lines
 ///////////////////////////////////////////////////////////////
-boolean Lines::update() {
-  if (!timeToUpdate()) return false;
-  /*
-  Serial.print("Current row = ");
-  Serial.print(_currentRow);
-  Serial.print(", Current col = ");
-  Serial.println(_currentCol);
-  */
-  // Do row
-  uint8_t prevRow = _currentRow;
-  if ((_currentRow == _height - 1) || (_currentRow == 0)) {
-    _rowIncrement *= -1;
-    _rowColorIndex = (_rowColorIndex + 16) % 256;
-  }
-  _currentRow += _rowIncrement;
-  for (int x = 0; x < _width; x++) {
-    _leds[XY(x, prevRow)] = CRGB::Black;  // Erase last row
-    _leds[XY(x, _currentRow)] = ColorFromPalette(getPalette(), _rowColorIndex, 128, _blending);
-  }
-  
-  // Do col
-  uint8_t prevCol = _currentCol;
-  if ((_currentCol == _width - 1) || (_currentCol == 0)) {
-    _colIncrement *= -1;
-    _colColorIndex = (_colColorIndex + 16) % 256;
-  }
-  _currentCol += _colIncrement;
-  for (int y = 0; y < _height; y++) {
-    if (y == _currentRow) {
-      _leds[XY(_currentCol, y)] = CRGB::Black;  // Pixel at intersection gets different color
-    } else if (y != prevRow) {
-      _leds[XY(prevCol, y)] = CRGB::Black;
-      _leds[XY(_currentCol, y)] = ColorFromPalette(getPalette(), _colColorIndex, 128, _blending);
-    } else {
-     _leds[XY(_currentCol, y)] = ColorFromPalette(getPalette(), _colColorIndex, 128, _blending); 
-    } 
- 
+boolean Lines::update(uint32_t dtMS) {
+  if (!_canvas.ready()) return false;
+  uint8_t steps = stepsDue(dtMS);
+  if (!steps) return false;
+
+  uint8_t  scale = _canvas.scale();
+  uint16_t lastRow = _canvas.height() - scale;
+  uint16_t lastCol = _canvas.width() - scale;
+  while (steps--) {
+    if ((_currentRow == lastRow) || (_currentRow == 0)) {
+      _rowIncrement *= -1;
+      _rowColorIndex = (_rowColorIndex + 16) % 256;
+    }
+    _currentRow += _rowIncrement;
+
+    if ((_currentCol == lastCol) || (_currentCol == 0)) {
+      _colIncrement *= -1;
+      _colColorIndex = (_colColorIndex + 16) % 256;
+    }
+    _currentCol += _colIncrement;
   }
-  FastLED.show();
+
+  // Both lines are an LED thick.  Where they cross is black.
+  _canvas.clear();
+  _canvas.fillRect(0, _currentRow, _canvas.width(), scale, paletteColor(_rowColorIndex, 128));
+  _canvas.fillRect(_currentCol, 0, scale, _canvas.height(), paletteColor(_colColorIndex, 128));
+  _canvas.fillRect(_currentCol, _currentRow, scale, scale, CRGB::Black);
+  downsample(_canvas);
   return true;
 }
 
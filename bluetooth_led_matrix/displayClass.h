@@ -4,10 +4,69 @@
 #define MAX_TEXT_CHARS    256
 #define MAX_TEXT_COLUMNS  MAX_TEXT_CHARS*6  // Max 5 cols per char + 1 blank column for intra-char spacing
 #include <FastLED.h>
+#include "compositor.h"
+#include "paletteMorph.h"
+#include "effectScratch.h"
+#include "matrixGeometry.h"
+#include "superCanvas.h"
+#include "particleSystem.h"
 
-// Palettes from FastLED library
-static CRGBPalette16 matrixPaletteList[] = {RainbowColors_p, CloudColors_p, PartyColors_p, OceanColors_p, LavaColors_p};
-static const int numPalettes = sizeof(matrixPaletteList)/sizeof(matrixPaletteList[0]);
+///////////////////////////////////////////////////////////////////////
+//  Keeps track of a scroll position in fixed point (24.8) columns, so
+//  the position moves at a set number of columns per second no matter
+//  how often it is advanced.  Whole column is column(), the part of the
+//  way to the next column is fraction().
+///////////////////////////////////////////////////////////////////////
+class SubPixelScroller {
+
+public:
+  SubPixelScroller(uint16_t colsPerSec = 5) { _speed = colsPerSec; reset(); };
+  void      reset(uint16_t col = 0) { _pos = (uint32_t)col << 8; _remainder = 0; };
+  void      setSpeed(uint16_t colsPerSec) { _speed = colsPerSec; };
+  uint16_t  getSpeed() { return _speed; };
+  void      advance(uint32_t dtMS);
+  uint16_t  column() { return _pos >> 8; };
+  fract8    fraction() { return _pos & 0xFF; };
+
+private:
+  uint32_t  _pos;        // Position in 1/256 columns
+  uint16_t  _remainder;  // Leftover 1/256000 columns from the last advance
+  uint16_t  _speed;      // Columns per second
+};
+
+// Longest time step an effect will integrate in one update.  Anything longer
+// (e.g. after a long BLE read) is treated as this long so motion doesn't jump.
+#define MAX_UPDATE_DT_MS  100UL
+
+///////////////////////////////////////////////////////////////////////
+//  Fixed timestep scheduler.  Elapsed time goes into an accumulator and
+//  comes out as whole steps of stepMS, so an effect runs at exactly its
+//  step rate however late it gets called.  If more than maxSteps are due
+//  at once the extra time is dropped (and counted) instead of trying to
+//  catch up forever.  Only the last of several steps is ever shown, so
+//  falling behind skips frames rather than slowing the animation.
+///////////////////////////////////////////////////////////////////////
+class FrameScheduler {
+
+public:
+  FrameScheduler(uint16_t stepMS, uint8_t maxSteps = 4) { _stepMS = stepMS; _maxSteps = maxSteps; _frameMS = 0; _missed = 0; _skipped = 0; reset(); };
+  void      reset() { _accumulator = _stepMS; };  // So the next advance runs a step right away
+  uint8_t   advance(uint32_t dtMS);
+  void      setStep(uint16_t ms) { _stepMS = ms; };
+  uint16_t  getStep() { return _stepMS; };
+  void      setFrameInterval(uint16_t ms) { _frameMS = ms; };   // How often advance() is meant to be called
+  uint16_t  missedDeadlines() { return _missed; };  // Times more steps were due than one frame interval holds
+  uint32_t  skippedSteps() { return _skipped; };    // Steps dropped by the catch-up cap
+  void      clearStats() { _missed = 0; _skipped = 0; };
+
+private:
+  uint32_t  _accumulator;
+  uint16_t  _stepMS;
+  uint8_t   _maxSteps;
+  uint16_t  _frameMS;
+  uint16_t  _missed;
+  uint32_t  _skipped;
+};
 
 ///////////////////////////////////////////////////////////////////////
 //  Main base class for matrix LED functions.  Pure virtual class that 
@@ -18,47 +77,63 @@ class DisplayMatrix {
 
 public:
 
-	DisplayMatrix(CRGB *leds, CRGB *buf,  uint8_t w, uint8_t h, uint16_t delayMS = 200, uint8_t palIndex = 0, TBlendType blending = LINEARBLEND) { 
-	  _lastUpdateTime = -1; _leds = leds; _buffer = buf;  _width = w; _height = h; _delayMS = delayMS, _paletteIndex = palIndex; _blending = blending;
+	DisplayMatrix(CRGB *leds, uint16_t w, uint16_t h, uint16_t delayMS = 200) : _scheduler(delayMS) { 
+	  _leds = leds; _geom.set(w, h); assert(_geom.matches(w, h));
 	}
+  virtual ~DisplayMatrix() {}
 
   // Pure virtual functions must be overriden in child classes
 	virtual void init() = 0;
-	virtual boolean update() = 0;
+	virtual boolean update(uint32_t dtMS) = 0;   // dtMS = real time since the last update. True if _leds changed
+
+  // Called on activation with freshly zeroed scratch memory, for effects
+  // that keep per pixel or per particle state.  False if it didn't all fit.
+  // Effects that claim any also say how much they need on a w x h matrix,
+  // so the arena can be sized at compile time.
+  virtual boolean claimScratch(EffectScratch &) { return true; }
+  static constexpr uint32_t scratchBytes(uint16_t, uint16_t) { return 0; }
+
+  // Where the effect draws
+  void  setLeds(CRGB *leds) { _leds = leds; };
+  CRGB* getLeds() { return _leds; };
+
+  // Timing functions
+  uint8_t         stepsDue(uint32_t dtMS) { return _scheduler.advance(dtMS); };
+  FrameScheduler& scheduler() { return _scheduler; };
 
-  // Helper function
-  boolean timeToUpdate();
+  // Warm start.  Effects that take a while to fill up say how much time
+  // they want run off-screen when activated, and preRoll() runs it (or as
+  // much as fits in budgetMS of real time).
+  virtual uint16_t preRollMS() { return 0; };
+  void             preRoll(uint16_t budgetMS);
 
   // Matrix math funcitons - from fastLED example
-  uint16_t XY( uint8_t x, uint8_t y);
-  uint16_t XYsafe( uint8_t x, uint8_t y);
+  uint16_t XY( MatrixCoord x, MatrixCoord y) { return _geom.XY(x, y); };
+  int32_t  XYsafe( int32_t x, int32_t y);    // -1 (the safety pixel) when off the matrix
+  uint16_t snakeXY(uint16_t i);
   
   // Matrix manipulation functions
   void shiftOneDown(CRGB *leds);
   void shiftOneUp(CRGB *leds);
   void shiftOneRight(CRGB *leds);
   void shiftOneLeft(CRGB *leds);
-  void shiftPercentDown(int percent, CRGB* nextRow);
-  void shiftPercentLeft(int percent, CRGB* nextCol);
-  void copyMatrix(CRGB *from, CRGB *to, uint8_t nLeds);
+  void copyMatrix(CRGB *from, CRGB *to, uint16_t nLeds);
+  void downsample(const SuperCanvas &canvas) { canvas.downsample(_leds, _geom); };    // Box filters the canvas onto _leds
+  void drawScrolledColumns(const uint8_t *cols, int16_t firstCol, uint16_t nCols, fract8 fraction, CRGB color);
   void clearDisplay();
 
-  // Palette functions
-  CRGBPalette16 getPalette() {return matrixPaletteList[_paletteIndex]; };
-  void nextPalette() { _paletteIndex = (_paletteIndex + 1) % numPalettes; };
+  // Palette functions - all effects share the one (possibly morphing) palette
+  const CRGBPalette16& getPalette() { return matrixPalette.current(); };
+  CRGB paletteColor(uint8_t index, uint8_t brightness = 255) { return matrixPalette.color(index, brightness); };
+  void nextPalette() { matrixPalette.next(); };
 
 
 protected:
   // Data
-	long           _lastUpdateTime;
+  FrameScheduler _scheduler;
   CRGB          *_leds;
-  CRGB          *_buffer;
   CRGB           _color;
-  uint8_t        _width;
-  uint8_t        _height;
-  uint8_t        _paletteIndex;
-  uint16_t       _delayMS;
-  TBlendType     _blending;
+  MatrixGeometry _geom;    // Size and layout, constants unless MATRIX_RUNTIME_GEOMETRY
 
 };
 
@@ -138,17 +213,20 @@ private:
 //////////////////////////////////////////////////////////////////////////////////
 // Class whose function is to display scrolling text on the LED Matrix
 //////////////////////////////////////////////////////////////////////////////////
-class DrawText : public DisplayMatrix {
+class DrawText : public DisplayMatrix, public PixelMask {
 
 public:
-  DrawText(CRGB *leds, CRGB *buff, uint8_t w, uint8_t h, uint16_t delayMS = 200, uint8_t palIndex = 0, CRGB color = CRGB::Red) : DisplayMatrix( leds, buff, w, h, delayMS, palIndex ) { 
-    _colPtr = 0; _colLen = 0; _color = color; _textInBuffer = false;
+  DrawText(CRGB *leds, uint16_t w, uint16_t h, uint16_t delayMS = 16, CRGB color = CRGB::Red) : DisplayMatrix( leds, w, h, delayMS ) { 
+    _colLen = 0; _color = color; _textInBuffer = false; _maskMode = false;
   }
   void    init();
-  boolean update();
+  boolean update(uint32_t dtMS);
   boolean displayingText() { if (_textInBuffer || !_stringBuffer.isEmpty()) return true; else return false; };
-  void    setDelay(uint16_t ms) { _delayMS = ms; }
+  void    setSpeed(uint16_t colsPerSec) { _scroller.setSpeed(colsPerSec); };
   void    setColor(CRGB col) { _color = col; };
+  void    setMaskMode(boolean on) { _maskMode = on; };   // Text cuts letters out of the frame instead of drawing
+  boolean getMaskMode() { return _maskMode; };
+  void    applyMask(CRGB *out);
   boolean addStringToBuffer(const char* txt, uint8_t repeat = 3, uint8_t colIndex = 0) { return _stringBuffer.push(txt, repeat, colIndex); };
 
 // Functions
@@ -159,50 +237,105 @@ private:
 private:
   uint8_t   _displayBuffer[MAX_TEXT_COLUMNS];
   uint16_t  _colLen;
-  uint16_t  _colPtr;
+  SubPixelScroller  _scroller;
   CRGB      _color;
   boolean   _textInBuffer;
+  boolean   _maskMode;
   // Cirucluar buffer of strings to be displayed
   StringUnitBuffer  _stringBuffer;
   
 };
 
+///////////////////////////////////////////////////////////////////////////////
+//  Base for effects built on a ParticleSystem.  A subclass gives the physics,
+//  a pool size, a renderer and either emitters or particles set up in init(),
+//  and this runs the system one scheduler step at a time and draws it.
+///////////////////////////////////////////////////////////////////////////////
+class ParticleEffect : public DisplayMatrix {
+
+public:
+  ParticleEffect(CRGB *leds, uint16_t w, uint16_t h, const ParticleParams &params, uint16_t capacity, uint16_t delayMS = 20) :
+    DisplayMatrix( leds, w, h, delayMS ), _particles( w, h, params ) {
+    _capacity = capacity; _renderer = NULL;
+  };
+  void    init() { _scheduler.reset(); _particles.clear(); };
+  boolean update(uint32_t dtMS);
+  boolean claimScratch(EffectScratch &scratch) { return _particles.claim(scratch, _capacity); };
+
+// Functions
+protected:
+  virtual void spawn(uint16_t) {}   // Before each step, for effects that start particles themselves
+
+// Data
+protected:
+  ParticleSystem     _particles;
+  ParticleRenderer  *_renderer;    // Set by the subclass
+  uint16_t           _capacity;
+};
+
 //////////////////////////////////////////////////////////////////////////////////
-//  Class that displays multicolor falling raindrops on the LED Matrix
+//  Class that displays multicolor falling raindrops on the LED Matrix.  Each
+//  column starts a drop about once a second just above the top row, and it
+//  falls at its own speed until it has left the bottom.
 //////////////////////////////////////////////////////////////////////////////////
-class DisplayRain : public DisplayMatrix {
+class DisplayRain : public ParticleEffect {
   
 public:
-  DisplayRain(CRGB *leds, CRGB *buff, uint8_t w, uint8_t h, uint16_t delayMS = 1, uint8_t palIndex = 0) : DisplayMatrix( leds, buff, w, h, delayMS, palIndex ) {
-     _colorIndex = 0; _brightness = 64; _counter = 0;
-  }
-  void    init();
-  boolean update();
-  CRGB    nextColorFromPalette();
+  #define MAX_RAIN_DROPS  24
+  DisplayRain(CRGB *leds, uint16_t w, uint16_t h, uint16_t delayMS = 10) :
+    ParticleEffect( leds, w, h, physics, MAX_RAIN_DROPS, delayMS ), _look( w, h, 64 ) { _renderer = &_look; };
+  void     init();
+  uint16_t preRollMS() { return 1500; };   // Long enough for the first drops to reach the bottom
+  static constexpr uint32_t scratchBytes(uint16_t, uint16_t) { return ParticleSystem::scratchBytes(MAX_RAIN_DROPS); }
 
-  // Data
+// Functions
+protected:
+  void     spawn(uint16_t stepMS);
 
+// Data
 private:
-  uint8_t    _colorIndex;
-  uint8_t    _brightness;
-  uint8_t    _counter;
+  static const ParticleParams  physics;
+  ParticleEmitter              _cloud;    // Moved over each column that starts a drop
+  SplatParticleRenderer        _look;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
 //  Class that displays multiple pixels that bounce around the LED Matrix
 ///////////////////////////////////////////////////////////////////////////////
-class BouncingPixels : public DisplayMatrix {
+class BouncingPixels : public ParticleEffect {
   
 public:
   #define N_BOUNCING_PIXELS 6
-  BouncingPixels(CRGB *leds, CRGB *buff, uint8_t w, uint8_t h, uint16_t delayMS = 50, uint8_t palIndex = 0) : DisplayMatrix( leds, buff, w, h, delayMS, palIndex ) {};
+  BouncingPixels(CRGB *leds, uint16_t w, uint16_t h, uint16_t delayMS = 20) :
+    ParticleEffect( leds, w, h, physics, N_BOUNCING_PIXELS, delayMS ), _look( w, h, 100 ) { _renderer = &_look; };
   void init();
-  boolean update();
+  static constexpr uint32_t scratchBytes(uint16_t, uint16_t) { return ParticleSystem::scratchBytes(N_BOUNCING_PIXELS); }
 
 // Data
 private:
-  float       _pos[N_BOUNCING_PIXELS][2], _vel[N_BOUNCING_PIXELS][2];  // Position, velocity (x, y);  uints pixels, and pixels/sec
-  uint8_t     _col[N_BOUNCING_PIXELS];
+  static const ParticleParams  physics;
+  SplatParticleRenderer        _look;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//  Class that sprays particles up from the bottom middle of the LED Matrix.
+//  They fall back under gravity and fade out.
+///////////////////////////////////////////////////////////////////////////////
+class Fountain : public ParticleEffect {
+
+public:
+  #define N_FOUNTAIN_PARTICLES 32
+  Fountain(CRGB *leds, uint16_t w, uint16_t h, uint16_t delayMS = 20) :
+    ParticleEffect( leds, w, h, physics, N_FOUNTAIN_PARTICLES, delayMS ), _look( w, h, 160, true ) { _renderer = &_look; };
+  void     init();
+  uint16_t preRollMS() { return 1500; };   // Long enough for the first particles to come down
+  static constexpr uint32_t scratchBytes(uint16_t, uint16_t) { return ParticleSystem::scratchBytes(N_FOUNTAIN_PARTICLES); }
+
+// Data
+private:
+  static const ParticleParams  physics;
+  ParticleEmitter              _spout;
+  SplatParticleRenderer        _look;
 };
 
 /////////////////////////////////////////////////////////////////////////////
@@ -211,18 +344,27 @@ private:
 class GameOfLife : public DisplayMatrix {
 
 public:
-  GameOfLife(CRGB *leds, CRGB *buff, uint8_t w, uint8_t h, uint16_t delayMS = 50, uint8_t palIndex = 0) : DisplayMatrix( leds, buff, w, h, delayMS, palIndex ) {
-    _brightness = 40; _counter = 0;
+  GameOfLife(CRGB *leds, uint16_t w, uint16_t h, uint16_t delayMS = 50) : DisplayMatrix( leds, w, h, delayMS ) {
+    _brightness = 40; _counter = 0; _showPtr = 0; _cells[0] = NULL; _cells[1] = NULL;
   }
   void    init();
-  boolean update();
+  boolean update(uint32_t dtMS);
+  boolean claimScratch(EffectScratch &scratch) { _cells[0] = scratch.bytePlane(_geom.nLeds()); _cells[1] = scratch.bytePlane(_geom.nLeds()); return _cells[1] != NULL; };
+  static constexpr uint32_t scratchBytes(uint16_t w, uint16_t h) { return 2 * (uint32_t)w * h; }
+  uint16_t preRollMS() { return 20 * _scheduler.getStep(); };   // Past the random first generations
   int     countNeighbors(int ptr, int x, int y);
   void    setDisplayPixels(int ptr);
+
+// Functions
+private:
+  boolean step();
   
 // Data
 private:
   uint8_t        _brightness;
   uint8_t        _counter;
+  uint8_t        _showPtr;   // Plane holding the newest generation
+  uint8_t       *_cells[2];  // Age of each cell (0 = dead) for the last two generations
 };
 ////////////////////////////////////////////////////////////////////////////////////////
 //  Class that displays pixels "twinkling" on and off with different colors randomly
@@ -230,16 +372,22 @@ private:
 class Twinkle : public DisplayMatrix {
 
 public:
-  Twinkle(CRGB *leds, CRGB *buff, uint8_t w, uint8_t h, uint16_t delayMS = 5, uint8_t palIndex = 0) : DisplayMatrix( leds, buff, w, h, delayMS, palIndex ) {
+  Twinkle(CRGB *leds, uint16_t w, uint16_t h, uint16_t delayMS = 5) : DisplayMatrix( leds, w, h, delayMS ) {
      _oddsFilled = round(255/.15); // time pixel is lit/15% lit at any time
+     _lit = NULL; _hue = NULL; _age = NULL;
   }
   void      init();
-  boolean   update();
-  boolean   isLit(uint8_t i) { if (_buffer[i][0]) return true; else return false; };
+  boolean   update(uint32_t dtMS);
+  boolean   claimScratch(EffectScratch &scratch);
+  static constexpr uint32_t scratchBytes(uint16_t w, uint16_t h) { return ((uint32_t)w * h + 7) / 8 + 2 * (uint32_t)w * h; }
+  uint16_t  preRollMS() { return 1000; };   // About one twinkle's lifetime
+  boolean   isLit(uint16_t i) { return getBit(_lit, i); };
 
 // Data
 private:
   uint16_t    _oddsFilled;   // 
+  uint8_t    *_lit;          // Bit per pixel, set while it is twinkling
+  uint8_t    *_hue, *_age;   // Byte per pixel
 };
 
 /////////////////////////////////////////////////////////////////////////////////////
@@ -249,15 +397,20 @@ private:
 class Worm : public DisplayMatrix {
   
 public:
-  Worm(CRGB *leds, CRGB *buff, uint8_t w, uint8_t h, uint16_t delayMS = 50, uint8_t palIndex = 0) : DisplayMatrix( leds, buff, w, h, delayMS, palIndex ) {
+  Worm(CRGB *leds, uint16_t w, uint16_t h, uint16_t delayMS = 50) : DisplayMatrix( leds, w, h, delayMS ) {
     _front = 7, _length = 7; _dir = 1; _colorIndex = 0;
   }
   void    init();
-  boolean update();
+  boolean update(uint32_t dtMS);
   
 // Data
 private:
-  uint8_t     _front, _length, _dir;
+  // Signed and a size wider than an index, so stepping past either end can't wrap
+  typedef SelectType<sizeof(MatrixIndex) == 1, int16_t, int32_t>::type  Position;
+
+  Position    _front;
+  MatrixIndex _length;
+  int8_t      _dir;
   uint8_t     _colorIndex;  // Index into the palette
 };
 
@@ -266,17 +419,21 @@ private:
 //////////////////////////////////////////////////////////////////////////////////
 class Lines : public DisplayMatrix {
 public:
-  Lines(CRGB *leds, CRGB *buff, uint8_t w, uint8_t h, uint16_t delayMS = 150, uint8_t palIndex = 0) : DisplayMatrix( leds, buff, w, h, delayMS, palIndex) {
-    _rowColorIndex = 1; _colColorIndex = 1; _currentRow = 1; _currentCol = 1; _rowIncrement = 1; _colIncrement = 1;
+  Lines(CRGB *leds, uint16_t w, uint16_t h, uint16_t delayMS = 150) : DisplayMatrix( leds, w, h, delayMS) {
+    _rowColorIndex = 1; _colColorIndex = 1; _currentRow = 1; _currentCol = 1; _rowIncrement = 1; _colIncrement = 1; _moveMS = delayMS;
   }
   void    init();
-  boolean update(); 
+  boolean update(uint32_t dtMS); 
+  boolean claimScratch(EffectScratch &scratch);
+  static constexpr uint32_t scratchBytes(uint16_t w, uint16_t h) { return SuperCanvas::scratchBytes(w, h); }
 
 // Data
 private:
-  uint8_t   _rowColorIndex, _colColorIndex;
-  uint8_t   _currentRow, _currentCol;
-  uint8_t   _rowIncrement, _colIncrement;
+  uint8_t     _rowColorIndex, _colColorIndex;
+  uint16_t    _currentRow, _currentCol;     // In canvas subpixels
+  int8_t      _rowIncrement, _colIncrement;
+  uint16_t    _moveMS;                      // Time to move one whole LED
+  SuperCanvas _canvas;
   
 };
 
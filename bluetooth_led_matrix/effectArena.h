@@ -0,0 +1,86 @@
+#ifndef __EFFECT_ARENA
+#define __EFFECT_ARENA
+
+#include <new>
+#include <assert.h>
+#include "displayClass.h"
+#include "effectScratch.h"
+
+///////////////////////////////////////////////////////////////////////
+//  Size, alignment and scratch memory (on a w x h matrix) of the
+//  largest of a list of effect classes, worked out at compile time.
+///////////////////////////////////////////////////////////////////////
+template <typename... Effects> struct LargestEffect;
+
+template <typename T> struct LargestEffect<T> {
+  static const size_t size  = sizeof(T);
+  static const size_t align = alignof(T);
+  static constexpr uint32_t scratchBytes(uint16_t w, uint16_t h) { return T::scratchBytes(w, h); }
+};
+
+template <typename T, typename... Rest> struct LargestEffect<T, Rest...> {
+  static const size_t size  = sizeof(T) > LargestEffect<Rest...>::size ? sizeof(T) : LargestEffect<Rest...>::size;
+  static const size_t align = alignof(T) > LargestEffect<Rest...>::align ? alignof(T) : LargestEffect<Rest...>::align;
+  static constexpr uint32_t scratchBytes(uint16_t w, uint16_t h) {
+    return T::scratchBytes(w, h) > LargestEffect<Rest...>::scratchBytes(w, h) ? T::scratchBytes(w, h) : LargestEffect<Rest...>::scratchBytes(w, h);
+  }
+};
+
+///////////////////////////////////////////////////////////////////////
+//  Registry of the background effects plus the memory to run them in.
+//  Rather than every effect sitting in RAM all the time, an effect is
+//  only constructed (into a slot sized for the largest one) when it is
+//  activated, and destroyed when something else takes its slot.  The
+//  effect numbers are the order of the classes in the template list.
+//  Each slot also has scratch memory, enough for the hungriest effect's
+//  scratchBytes() on a WIDTH x HEIGHT matrix, zeroed and handed to the
+//  effect's claimScratch() when it is activated.
+//
+//  A transition runs the outgoing and incoming effects together, so
+//  that takes two slots.
+///////////////////////////////////////////////////////////////////////
+template <uint8_t N_SLOTS, uint16_t WIDTH, uint16_t HEIGHT, typename... Effects>
+class EffectArena {
+
+public:
+  static const uint8_t     numEffects = sizeof...(Effects);
+  static const size_t      slotBytes  = LargestEffect<Effects...>::size;
+  static constexpr uint32_t scratchBytes = LargestEffect<Effects...>::scratchBytes(WIDTH, HEIGHT);
+
+  EffectArena() { for (uint8_t i = 0; i < N_SLOTS; i++) _active[i] = NULL; };
+
+  // Constructs effect number effect in a slot, replacing whatever was there
+  DisplayMatrix* activate(uint8_t slot, uint8_t effect, CRGB *leds, uint16_t w, uint16_t h) {
+    static DisplayMatrix* (* const factories[])(void *, CRGB *, uint16_t, uint16_t) = { &construct<Effects>... };
+    release(slot);
+    _active[slot] = factories[effect](_slots[slot], leds, w, h);
+
+    // Only fails if w x h is bigger than WIDTH x HEIGHT, or an effect's
+    // scratchBytes() is less than its claimScratch() takes
+    EffectScratch scratch(_scratch[slot], scratchBytes);
+    scratch.reset();
+    boolean claimed = _active[slot]->claimScratch(scratch);
+    assert(claimed);
+    (void)claimed;     // When asserts are compiled out
+    return _active[slot];
+  };
+
+  void release(uint8_t slot) {
+    if (_active[slot]) {
+      _active[slot]->~DisplayMatrix();
+      _active[slot] = NULL;
+    }
+  };
+
+  DisplayMatrix* get(uint8_t slot) { return _active[slot]; };
+
+private:
+  template <typename T>
+  static DisplayMatrix* construct(void *mem, CRGB *leds, uint16_t w, uint16_t h) { return new (mem) T(leds, w, h); };
+
+  alignas(LargestEffect<Effects...>::align) uint8_t  _slots[N_SLOTS][slotBytes];
+  alignas(4) uint8_t  _scratch[N_SLOTS][scratchBytes ? scratchBytes : 1];
+  DisplayMatrix  *_active[N_SLOTS];
+};
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef __EFFECT_SCRATCH
+#define __EFFECT_SCRATCH
+
+#include <FastLED.h>
+
+///////////////////////////////////////////////////////////////////////
+//  Private working memory for one effect.  When an effect is activated
+//  the memory is zeroed and the effect asks for the pieces it needs:
+//  bit planes (one bit per pixel), byte planes (one byte per pixel) or
+//  pools of its own structs.  The effect keeps the pointers it gets,
+//  and they stay good until something else is activated in its place.
+//  Asking for more than is left returns NULL.
+///////////////////////////////////////////////////////////////////////
+class EffectScratch {
+
+public:
+  EffectScratch(uint8_t *mem, uint32_t size) { _mem = mem; _size = size; _used = 0; };
+  void      reset() { memset(_mem, 0, _size); _used = 0; };
+  uint8_t*  bitPlane(uint16_t nPixels) { return (uint8_t *)allocate((nPixels + 7) / 8, 1); };
+  uint8_t*  bytePlane(uint16_t nPixels) { return (uint8_t *)allocate(nPixels, 1); };
+  template <typename T>
+  T*        pool(uint32_t count) { return (T *)allocate((uint32_t)count * sizeof(T), alignof(T)); };
+  uint32_t  used() { return _used; };
+  uint32_t  capacity() { return _size; };
+
+private:
+  void* allocate(uint32_t nBytes, uint8_t align) {
+    uint8_t  pad = (uintptr_t)(_mem + _used) % align;
+    uint32_t start = _used + (pad ? align - pad : 0);
+    if (start + nBytes > _size) return NULL;
+    _used = start + nBytes;
+    return _mem + start;
+  };
+
+  uint8_t   *_mem;
+  uint32_t   _size;
+  uint32_t   _used;
+};
+
+// Bit plane access, pixel i is bit (i % 8) of byte i / 8
+static inline boolean getBit(const uint8_t *plane, uint16_t i) { return (plane[i >> 3] >> (i & 7)) & 1; }
+static inline void    setBit(uint8_t *plane, uint16_t i) { plane[i >> 3] |= 1 << (i & 7); }
+static inline void    clearBit(uint8_t *plane, uint16_t i) { plane[i >> 3] &= ~(1 << (i & 7)); }
+
+#endif
@@ -0,0 +1,214 @@
+/////////////////////////////////////////////////////
+//  Functions for the LedOutput stage
+/////////////////////////////////////////////////////
+
+#include "ledOutput.h"
+
+#if defined(TEENSYDUINO)
+#include <SPI.h>
+#include <EventResponder.h>
+
+// Set by the SPI driver when a DMA transfer completes
+static EventResponder    spiEvent;
+static volatile boolean  spiBusy = false;
+
+static void spiTransferDone(EventResponderRef event) {
+  SPI.endTransaction();
+  spiBusy = false;
+}
+#endif
+
+/////////////////////////////////////////////////////
+// Sets the global brightness.  Done by FastLED unless
+// dithering, when it is folded into the 16 bit values.
+/////////////////////////////////////////////////////
+void LedOutput::setBrightness(uint8_t brightness) {
+  _brightness = brightness;
+  if (!dithering()) FastLED.setBrightness(brightness);
+}
+
+/////////////////////////////////////////////////////
+// Turns on temporal dithering using the given buffers.
+// FastLED's own dithering is turned off so the two
+// don't fight.  The starting errors are scattered so
+// pixels at the same level don't all step together.
+// Direct APA102 output doesn't go through the dither
+// stage, so there it does nothing and returns false.
+/////////////////////////////////////////////////////
+boolean LedOutput::enableDither(uint16_t *target, uint8_t *error) {
+  if (directOutput()) return false;
+  uint32_t nChannels = (uint32_t)_nLeds * 3;
+  for (uint32_t i = 0; i < nChannels; i++) {
+    target[i] = 0;
+    error[i] = (uint8_t)(i * 157);
+  }
+  _target = target;
+  _error = error;
+  FastLED.setBrightness(255);
+  FastLED.setDither(DISABLE_DITHER);
+  return true;
+}
+
+void LedOutput::disableDither() {
+  _target = NULL;
+  _error = NULL;
+  if (!directOutput()) FastLED.setBrightness(_brightness);
+}
+
+/////////////////////////////////////////////////////
+// Corrects the frame into the LED array and shows it.
+// When dithering, the corrected and brightness scaled
+// frame goes into the 16 bit targets instead.
+/////////////////////////////////////////////////////
+void LedOutput::show(const CRGB *frame) {
+  const uint8_t *r = _lut->r, *g = _lut->g, *b = _lut->b;
+
+  if (directOutput()) {
+    encodeDirect(frame);
+    if (_frontBuffer) {
+      // Hand the new frame over to the DMA side
+      if (busy()) {
+        unsigned long waitStart = micros();
+        _stalls++;
+        while (busy()) ;
+        _stallMicros += micros() - waitStart;
+      }
+      uint8_t *sent = _frontBuffer;
+      _frontBuffer = _txBuffer;
+      _txBuffer = sent;
+      startTransfer(_frontBuffer, APA102_FRAME_BYTES(_nLeds));
+    } else {
+      transmit(_txBuffer, APA102_FRAME_BYTES(_nLeds));
+    }
+    return;
+  }
+
+  if (dithering()) {
+    uint16_t  scale = (uint16_t)_brightness + 1;
+    uint16_t *t = _target;
+    for (uint16_t i = 0; i < _nLeds; i++) {
+      const CRGB &p = pixel(frame, i);
+      *t++ = r[p.r] * scale;
+      *t++ = g[p.g] * scale;
+      *t++ = b[p.b] * scale;
+    }
+    _bytesWritten = (uint32_t)_nLeds * 3 * (sizeof(uint16_t) + 2);   // Targets, then refresh()'s LEDs and errors
+    refresh();
+    return;
+  }
+
+  for (uint16_t i = 0; i < _nLeds; i++) {
+    const CRGB &p = pixel(frame, i);
+    _leds[i].r = r[p.r];
+    _leds[i].g = g[p.g];
+    _leds[i].b = b[p.b];
+  }
+  _bytesWritten = (uint32_t)_nLeds * sizeof(CRGB);
+  FastLED.show();
+}
+
+/////////////////////////////////////////////////////
+// Correction, brightness and APA102 encoding in one
+// pass from the frame into the pixel part of the
+// transmit buffer.  Nothing else in the buffer is
+// touched, so 4 bytes per LED are written in total.
+/////////////////////////////////////////////////////
+void LedOutput::encodeDirect(const CRGB *frame) {
+  const uint8_t *r = _lut->r, *g = _lut->g, *b = _lut->b;
+  uint16_t       scale = (uint16_t)_brightness + 1;
+  uint8_t       *out = Apa102Encoder::pixelData(_txBuffer);
+
+  for (uint16_t i = 0; i < _nLeds; i++) {
+    const CRGB &p = pixel(frame, i);
+    Apa102Encoder::encodePixel(r[p.r] * scale, g[p.g] * scale, b[p.b] * scale, out);
+    out += 4;
+  }
+  _bytesWritten = (uint32_t)_nLeds * 4;
+}
+
+/////////////////////////////////////////////////////
+// Shows the next dithered version of the last frame.
+// One straight pass over the channels, integer only.
+/////////////////////////////////////////////////////
+void LedOutput::refresh() {
+  if (!dithering() || directOutput()) return;
+
+  uint8_t  *out = (uint8_t *)_leds;    // CRGB is three bytes, r g b
+  uint32_t  nChannels = (uint32_t)_nLeds * 3;
+  for (uint32_t i = 0; i < nChannels; i++) {
+    uint16_t v = _target[i] + _error[i];
+    out[i] = v >> 8;
+    _error[i] = v & 0xFF;
+  }
+  FastLED.show();
+}
+
+/////////////////////////////////////////////////////
+// Switches to driving the strip directly with 5 bit
+// current control.  The start and end frames are
+// written into txBuffer here and never again.
+/////////////////////////////////////////////////////
+void LedOutput::enableApa102(uint8_t dataPin, uint8_t clockPin, uint8_t *txBuffer) {
+  Apa102Encoder::prepareFrame(_nLeds, txBuffer);
+  _dataPin = dataPin;
+  _clockPin = clockPin;
+  _txBuffer = txBuffer;
+  pinMode(_dataPin, OUTPUT);
+  pinMode(_clockPin, OUTPUT);
+  digitalWriteFast(_clockPin, LOW);
+}
+
+/////////////////////////////////////////////////////
+// Bit-bangs bytes out MSB first.  Pins 4 and 5 aren't
+// hardware SPI pins on the Teensy, so this is what
+// FastLED does for them too.
+/////////////////////////////////////////////////////
+void LedOutput::transmit(const uint8_t *data, uint32_t nBytes) {
+  for (uint32_t i = 0; i < nBytes; i++) {
+    uint8_t b = data[i];
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      digitalWriteFast(_dataPin, (b & 0x80) ? HIGH : LOW);
+      digitalWriteFast(_clockPin, HIGH);
+      b <<= 1;
+      digitalWriteFast(_clockPin, LOW);
+    }
+  }
+}
+
+/////////////////////////////////////////////////////
+// Switches to direct output over hardware SPI with
+// DMA, double buffered.  The strip has to be wired
+// to the SPI pins (11 data, 13 clock on the Teensy).
+/////////////////////////////////////////////////////
+void LedOutput::enableApa102Dma(uint8_t *frontBuffer, uint8_t *backBuffer) {
+  Apa102Encoder::prepareFrame(_nLeds, frontBuffer);
+  Apa102Encoder::prepareFrame(_nLeds, backBuffer);
+  _frontBuffer = frontBuffer;
+  _txBuffer = backBuffer;
+#if defined(TEENSYDUINO)
+  spiEvent.attachImmediate(&spiTransferDone);
+  SPI.begin();
+#endif
+}
+
+boolean LedOutput::busy() {
+#if defined(TEENSYDUINO)
+  return spiBusy;
+#else
+  return (long)(_transferEnd - micros()) > 0;
+#endif
+}
+
+/////////////////////////////////////////////////////
+// Starts sending a frame and returns without waiting
+/////////////////////////////////////////////////////
+void LedOutput::startTransfer(const uint8_t *data, uint32_t nBytes) {
+#if defined(TEENSYDUINO)
+  spiBusy = true;
+  SPI.beginTransaction(SPISettings(LED_SPI_CLOCK, MSBFIRST, SPI_MODE0));
+  SPI.transfer(data, NULL, nBytes, spiEvent);
+#else
+  (void)data;   // Nothing really goes out off the board
+  _transferEnd = micros() + transferMicros(nBytes);
+#endif
+}
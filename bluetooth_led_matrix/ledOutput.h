@@ -0,0 +1,139 @@
+#ifndef __LED_OUTPUT
+#define __LED_OUTPUT
+
+#include <FastLED.h>
+#include "apa102.h"
+
+// SPI clock for DMA output
+#define LED_SPI_CLOCK  8000000
+
+///////////////////////////////////////////////////////////////////////
+//  Per-channel output lookup tables.  Effects work in perceptual
+//  (gamma encoded) values, and the output stage runs every pixel
+//  through one of these just before the LEDs are updated.
+///////////////////////////////////////////////////////////////////////
+struct ColorLUT {
+  uint8_t r[256];
+  uint8_t g[256];
+  uint8_t b[256];
+};
+
+// Gamma 2.2, with every nonzero input kept at least 1 so dim pixels don't vanish
+constexpr uint8_t gamma22Table[256] = {
+    0,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,
+    1,   1,   1,   1,   1,   1,   1,   1,   1,   2,   2,   2,   2,   2,   2,   2,
+    3,   3,   3,   3,   3,   4,   4,   4,   4,   5,   5,   5,   5,   6,   6,   6,
+    6,   7,   7,   7,   8,   8,   8,   9,   9,   9,  10,  10,  11,  11,  11,  12,
+   12,  13,  13,  13,  14,  14,  15,  15,  16,  16,  17,  17,  18,  18,  19,  19,
+   20,  20,  21,  22,  22,  23,  23,  24,  25,  25,  26,  26,  27,  28,  28,  29,
+   30,  30,  31,  32,  33,  33,  34,  35,  35,  36,  37,  38,  39,  39,  40,  41,
+   42,  43,  43,  44,  45,  46,  47,  48,  49,  49,  50,  51,  52,  53,  54,  55,
+   56,  57,  58,  59,  60,  61,  62,  63,  64,  65,  66,  67,  68,  69,  70,  71,
+   73,  74,  75,  76,  77,  78,  79,  81,  82,  83,  84,  85,  87,  88,  89,  90,
+   91,  93,  94,  95,  97,  98,  99, 100, 102, 103, 105, 106, 107, 109, 110, 111,
+  113, 114, 116, 117, 119, 120, 121, 123, 124, 126, 127, 129, 130, 132, 133, 135,
+  137, 138, 140, 141, 143, 145, 146, 148, 149, 151, 153, 154, 156, 158, 159, 161,
+  163, 165, 166, 168, 170, 172, 173, 175, 177, 179, 181, 182, 184, 186, 188, 190,
+  192, 194, 196, 197, 199, 201, 203, 205, 207, 209, 211, 213, 215, 217, 219, 221,
+  223, 225, 227, 229, 231, 234, 236, 238, 240, 242, 244, 246, 248, 251, 253, 255
+};
+
+///////////////////////////////////////////////////////////////////////
+// Builds a table at compile time from the gamma table and a white
+// balance scale for each channel (255 = full).
+///////////////////////////////////////////////////////////////////////
+constexpr uint8_t whiteBalance(uint8_t v, uint8_t scale) {
+  return (v && scale) ? (uint8_t)max(1, (v * scale + 127) / 255) : 0;
+}
+
+constexpr ColorLUT makeColorLUT(uint8_t rScale, uint8_t gScale, uint8_t bScale, bool gamma = true) {
+  ColorLUT lut = {};
+  for (int i = 0; i < 256; i++) {
+    uint8_t v = gamma ? gamma22Table[i] : i;
+    lut.r[i] = whiteBalance(v, rScale);
+    lut.g[i] = whiteBalance(v, gScale);
+    lut.b[i] = whiteBalance(v, bScale);
+  }
+  return lut;
+}
+
+// Tables to choose from at runtime
+constexpr ColorLUT smd5050GammaLUT = makeColorLUT(255, 176, 240);          // Same balance as TypicalSMD5050
+constexpr ColorLUT neutralGammaLUT = makeColorLUT(255, 255, 255);
+constexpr ColorLUT smd5050LinearLUT = makeColorLUT(255, 176, 240, false);  // White balance only
+
+///////////////////////////////////////////////////////////////////////
+//  Final stage before the LEDs.  Takes the composited frame, runs it
+//  through the current lookup table into the LED array in one pass,
+//  and shows it.  The frame is read in wiring order through the pixel
+//  map, if there is one.
+//
+//  With temporal dithering on, global brightness is applied here
+//  instead of by FastLED.  Each channel is kept as a 16 bit (8.8) value
+//  and refresh() shows the integer part, carrying the fraction over to
+//  the next refresh.  A pixel that should be at 1.25 is then at 1 three
+//  refreshes out of four and 2 the other, so dim colors keep their
+//  levels instead of rounding to a few steps.  refresh() needs calling
+//  much more often than new frames arrive so this doesn't flicker.
+//
+//  With direct APA102 output on, each pixel is corrected, scaled to 16
+//  bits and encoded with the chips' 5 bit current control (see apa102.h)
+//  in a single pass, straight into a transmit buffer whose start and end
+//  frames were written once up front.  The buffer is then clocked out on
+//  the data/clock pins, bypassing FastLED.  That gives enough range that
+//  no dithering is needed, and enableDither() refuses.
+//
+//  With DMA output the strip is on the hardware SPI pins and there are
+//  two transmit buffers.  show() encodes into the back buffer, swaps it
+//  to the front and starts the transfer, then returns straight away so
+//  the next frame can be drawn while this one goes out.  It only waits
+//  if the previous transfer still hasn't finished.  Off the Teensy the
+//  transfer isn't real, but busy() still follows how long it would take.
+///////////////////////////////////////////////////////////////////////
+class LedOutput {
+
+public:
+  LedOutput(CRGB *leds, uint16_t nLeds, const uint16_t *map, const ColorLUT *lut = &smd5050GammaLUT) { 
+    _leds = leds; _nLeds = nLeds; _lut = lut; _map = map; _brightness = 255; _target = NULL; _error = NULL; _txBuffer = NULL; _frontBuffer = NULL; _bytesWritten = 0; _stalls = 0; _stallMicros = 0; _transferEnd = 0;
+  };
+  void            setPixelMap(const uint16_t *map) { _map = map; };   // Canvas pixel for each LED, never NULL
+  void            setLUT(const ColorLUT *lut) { _lut = lut; };
+  const ColorLUT* getLUT() { return _lut; };
+  void            setBrightness(uint8_t brightness);
+  boolean         enableDither(uint16_t *target, uint8_t *error);   // Both need 3*nLeds entries.  False with direct output
+  void            disableDither();
+  boolean         dithering() { return _target != NULL; };
+  void            enableApa102(uint8_t dataPin, uint8_t clockPin, uint8_t *txBuffer);  // txBuffer needs APA102_FRAME_BYTES(nLeds)
+  boolean         directOutput() { return _txBuffer != NULL; };
+  void            enableApa102Dma(uint8_t *frontBuffer, uint8_t *backBuffer);         // Both need APA102_FRAME_BYTES(nLeds)
+  boolean         busy();                                      // DMA transfer still going
+  uint16_t        stalls() { return _stalls; };                // Times show() had to wait for the last transfer
+  uint32_t        stallMicros() { return _stallMicros; };      // Total time spent waiting.  The rest of each transfer overlapped drawing
+  static uint32_t transferMicros(uint32_t nBytes) { return (uint64_t)nBytes * 8 * 1000 / (LED_SPI_CLOCK / 1000); };
+  uint32_t        bytesWritten() { return _bytesWritten; };   // Buffer bytes written for the last frame
+  void            show(const CRGB *frame);
+  void            refresh();
+
+private:
+  void            transmit(const uint8_t *data, uint32_t nBytes);
+  void            encodeDirect(const CRGB *frame);
+  void            startTransfer(const uint8_t *data, uint32_t nBytes);
+  const CRGB&     pixel(const CRGB *frame, uint16_t i) { return frame[_map[i]]; };
+
+  CRGB            *_leds;
+  uint16_t         _nLeds;
+  const ColorLUT  *_lut;
+  const uint16_t  *_map;       // Wiring order, see panelMap.h.  Always set, so no test per pixel
+  uint8_t          _brightness;
+  uint16_t        *_target;    // Wanted output for each channel, 8.8 fixed point
+  uint8_t         *_error;     // Fraction carried over from the last refresh
+  uint8_t         *_txBuffer;  // Encoded APA102 frame when driving the strip directly
+  uint8_t         *_frontBuffer; // Frame being sent by DMA, NULL when bit-banging
+  uint8_t          _dataPin, _clockPin;
+  uint32_t         _bytesWritten;
+  uint16_t         _stalls;
+  uint32_t         _stallMicros;
+  unsigned long    _transferEnd; // Modelled end of the transfer, off the Teensy
+};
+
+#endif
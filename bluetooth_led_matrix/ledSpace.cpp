@@ -0,0 +1,95 @@
+/////////////////////////////////////////////////////
+//  Functions for LedSpace
+/////////////////////////////////////////////////////
+
+#include "ledSpace.h"
+
+static inline uint32_t distance2(const LedCoord &c, uint8_t x, uint8_t y) {
+  int32_t dx = (int32_t)c.x - x;
+  int32_t dy = (int32_t)c.y - y;
+  return dx * dx + dy * dy;
+}
+
+/////////////////////////////////////////////////////
+// Builds the grid index with a counting sort: count
+// the LEDs in each cell, turn the counts into start
+// positions, then drop each LED into its cell.
+/////////////////////////////////////////////////////
+void LedSpace::begin() {
+  const uint8_t nCells = LED_SPACE_GRID * LED_SPACE_GRID;
+
+  for (uint8_t c = 0; c <= nCells; c++) _cellStart[c] = 0;
+  for (uint16_t i = 0; i < _nLeds; i++) {
+    _cellStart[cellOf(_coords[i].y) * LED_SPACE_GRID + cellOf(_coords[i].x) + 1]++;
+  }
+  for (uint8_t c = 0; c < nCells; c++) _cellStart[c + 1] += _cellStart[c];
+
+  uint16_t fill[nCells];
+  for (uint8_t c = 0; c < nCells; c++) fill[c] = _cellStart[c];
+  for (uint16_t i = 0; i < _nLeds; i++) {
+    _order[fill[cellOf(_coords[i].y) * LED_SPACE_GRID + cellOf(_coords[i].x)]++] = i;
+  }
+}
+
+void LedSpace::searchCell(uint8_t cx, uint8_t cy, uint8_t x, uint8_t y, uint16_t &best, uint32_t &bestD2) {
+  uint8_t cell = cy * LED_SPACE_GRID + cx;
+  for (uint16_t k = _cellStart[cell]; k < _cellStart[cell + 1]; k++) {
+    uint32_t d2 = distance2(_coords[_order[k]], x, y);
+    if (d2 < bestD2) {
+      bestD2 = d2;
+      best = _order[k];
+    }
+  }
+}
+
+/////////////////////////////////////////////////////
+// Searches rings of cells outward from the one (x, y)
+// is in.  Anything in the next ring out is at least
+// ring cells away, so once the best so far is closer
+// than that the search can stop.
+/////////////////////////////////////////////////////
+uint16_t LedSpace::nearest(uint8_t x, uint8_t y) {
+  uint16_t best = LED_SPACE_NONE;
+  uint32_t bestD2 = 0xFFFFFFFF;
+  int8_t   cx = cellOf(x), cy = cellOf(y);
+
+  for (int8_t ring = 0; ring < LED_SPACE_GRID; ring++) {
+    for (int8_t dy = -ring; dy <= ring; dy++) {
+      int8_t row = cy + dy;
+      if (row < 0 || row >= LED_SPACE_GRID) continue;
+      // Whole rows at the top and bottom of the ring, just the two ends otherwise
+      int8_t step = (dy == -ring || dy == ring) ? 1 : 2 * ring;
+      for (int8_t dx = -ring; dx <= ring; dx += step) {
+        int8_t col = cx + dx;
+        if (col >= 0 && col < LED_SPACE_GRID) searchCell(col, row, x, y, best, bestD2);
+      }
+    }
+    uint32_t reach = (uint32_t)ring * LED_SPACE_CELL;
+    if (best != LED_SPACE_NONE && bestD2 <= reach * reach) break;
+  }
+  return best;
+}
+
+/////////////////////////////////////////////////////
+// Finds the LEDs within r of (x, y), checking only
+// the cells the circle overlaps
+/////////////////////////////////////////////////////
+uint16_t LedSpace::inRadius(uint8_t x, uint8_t y, uint8_t r, uint16_t *found, uint16_t maxFound) {
+  uint8_t  x0 = cellOf(x > r ? x - r : 0), x1 = cellOf(x + r > 255 ? 255 : x + r);
+  uint8_t  y0 = cellOf(y > r ? y - r : 0), y1 = cellOf(y + r > 255 ? 255 : y + r);
+  uint32_t r2 = (uint32_t)r * r;
+  uint16_t n = 0;
+
+  for (uint8_t cy = y0; cy <= y1; cy++) {
+    for (uint8_t cx = x0; cx <= x1; cx++) {
+      uint8_t cell = cy * LED_SPACE_GRID + cx;
+      for (uint16_t k = _cellStart[cell]; k < _cellStart[cell + 1]; k++) {
+        if (distance2(_coords[_order[k]], x, y) <= r2) {
+          if (n == maxFound) return n;
+          found[n++] = _order[k];
+        }
+      }
+    }
+  }
+  return n;
+}
@@ -0,0 +1,47 @@
+#ifndef __LED_SPACE
+#define __LED_SPACE
+
+#include <stdint.h>
+
+///////////////////////////////////////////////////////////////////////
+//  Where an LED physically is, scaled to 0-255 on the longer side of
+//  the layout.  Tables of these are made from the layout drawing by
+//  design/svgToLedCoords.py.
+///////////////////////////////////////////////////////////////////////
+struct LedCoord {
+  uint8_t   x, y;
+};
+
+#define LED_SPACE_GRID  8                       // Index cells along each side
+#define LED_SPACE_CELL  (256 / LED_SPACE_GRID)  // Coordinate units per cell
+#define LED_SPACE_NONE  0xFFFF                  // No LED found
+
+///////////////////////////////////////////////////////////////////////
+//  LEDs at arbitrary positions, for layouts that aren't a grid.
+//  Effects can work out each LED's color from its real position, or
+//  look up which LEDs are at or around a point.  The LEDs are bucketed
+//  into a coarse grid of cells when begin() is called, so a lookup only
+//  looks at LEDs in the nearby cells rather than measuring to all of
+//  them.
+///////////////////////////////////////////////////////////////////////
+class LedSpace {
+
+public:
+  LedSpace(const LedCoord *coords, uint16_t nLeds, uint16_t *order) { _coords = coords; _nLeds = nLeds; _order = order; };  // order needs nLeds entries
+  void             begin();
+  uint16_t         nLeds() { return _nLeds; };
+  const LedCoord&  coord(uint16_t i) { return _coords[i]; };
+  uint16_t         nearest(uint8_t x, uint8_t y);    // LED closest to (x, y)
+  uint16_t         inRadius(uint8_t x, uint8_t y, uint8_t r, uint16_t *found, uint16_t maxFound);  // Returns how many were put in found
+
+private:
+  static uint8_t   cellOf(uint8_t v) { return v / LED_SPACE_CELL; };
+  void             searchCell(uint8_t cx, uint8_t cy, uint8_t x, uint8_t y, uint16_t &best, uint32_t &bestD2);
+
+  const LedCoord  *_coords;
+  uint16_t         _nLeds;
+  uint16_t        *_order;     // LED numbers sorted by cell
+  uint16_t         _cellStart[LED_SPACE_GRID * LED_SPACE_GRID + 1];   // Where each cell's LEDs start in _order
+};
+
+#endif
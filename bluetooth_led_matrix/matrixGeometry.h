@@ -0,0 +1,84 @@
+#ifndef __MATRIX_GEOMETRY
+#define __MATRIX_GEOMETRY
+
+#include <stdint.h>
+#include <assert.h>
+
+///////////////////////////////////////////////////////////////////////
+//  How the LEDs are chained through the matrix.  Progressive runs every
+//  row left to right, serpentine turns back at the end of each row.
+///////////////////////////////////////////////////////////////////////
+enum MatrixLayout { LAYOUT_PROGRESSIVE, LAYOUT_SERPENTINE };
+
+// Picks A if the condition holds, otherwise B
+template <bool C, typename A, typename B> struct SelectType { typedef A type; };
+template <typename A, typename B> struct SelectType<false, A, B> { typedef B type; };
+
+///////////////////////////////////////////////////////////////////////
+//  Matrix size and layout fixed at compile time.  Everything is a
+//  constant, so loops over the matrix have constant bounds and XY()
+//  folds down to a few shifts and adds.
+//
+//  Coord is the type for an x or y and Index the type for an LED number
+//  or count.  They are bytes when the matrix is small enough, so small
+//  matrices keep compact effect state, and 16 bits otherwise.
+//
+//  set() can't change the size, so whoever calls it asserts matches()
+//  afterwards to catch a size the build wasn't made for.
+///////////////////////////////////////////////////////////////////////
+template <uint16_t W, uint16_t H, MatrixLayout L = LAYOUT_SERPENTINE>
+struct FixedGeometry {
+  static_assert((uint32_t)W * H <= 0xFFFF, "Too many LEDs for 16 bit indexes");
+  typedef typename SelectType<(W < 256 && H < 256), uint8_t, uint16_t>::type  Coord;
+  typedef typename SelectType<((uint32_t)W * H < 256), uint8_t, uint16_t>::type  Index;
+
+  void                      set(uint16_t, uint16_t) {}
+  static constexpr bool     matches(uint16_t w, uint16_t h) { return w == W && h == H; }
+  static constexpr uint16_t width()  { return W; }
+  static constexpr uint16_t height() { return H; }
+  static constexpr uint16_t nLeds()  { return (uint16_t)W * H; }
+  static constexpr uint16_t XY(uint16_t x, uint16_t y) {
+    return (L == LAYOUT_SERPENTINE && (y & 0x01)) ? (uint16_t)y * W + (W - 1 - x) : (uint16_t)y * W + x;
+  }
+};
+
+///////////////////////////////////////////////////////////////////////
+//  Same interface, with the size set at run time (so always 16 bits)
+///////////////////////////////////////////////////////////////////////
+struct RuntimeGeometry {
+  typedef uint16_t  Coord;
+  typedef uint16_t  Index;
+
+  void      set(uint16_t w, uint16_t h) { _w = w; _h = h; }
+  bool      matches(uint16_t w, uint16_t h) const { return w == _w && h == _h; }
+  uint16_t  width() const  { return _w; }
+  uint16_t  height() const { return _h; }
+  uint16_t  nLeds() const  { return _w * _h; }
+  uint16_t  XY(uint16_t x, uint16_t y) const { return y * _w + x; }   // Progressive
+
+  uint16_t  _w, _h;
+};
+
+///////////////////////////////////////////////////////////////////////
+//  Geometry the effects are built for: the 10x6 canvas of the bag.  The
+//  canvas is laid out row by row, and the output stage puts it into
+//  wiring order (see panelMap.h).  Define MATRIX_WIDTH and
+//  MATRIX_HEIGHT to build for another fixed size, or define
+//  MATRIX_RUNTIME_GEOMETRY to take the size from the constructors
+//  instead, so other panels can run the same build.
+///////////////////////////////////////////////////////////////////////
+#ifndef MATRIX_WIDTH
+#define MATRIX_WIDTH   10
+#define MATRIX_HEIGHT  6
+#endif
+
+#ifdef MATRIX_RUNTIME_GEOMETRY
+typedef RuntimeGeometry  MatrixGeometry;
+#else
+typedef FixedGeometry<MATRIX_WIDTH, MATRIX_HEIGHT, LAYOUT_PROGRESSIVE>  MatrixGeometry;
+#endif
+
+typedef MatrixGeometry::Coord  MatrixCoord;
+typedef MatrixGeometry::Index  MatrixIndex;
+
+#endif
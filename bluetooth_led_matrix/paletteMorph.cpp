@@ -0,0 +1,84 @@
+/////////////////////////////////////////////////////
+//  Functions for the shared PaletteMorph
+/////////////////////////////////////////////////////
+
+#include "paletteMorph.h"
+
+PaletteMorph matrixPalette;
+
+/////////////////////////////////////////////////////
+// Jumps straight to a palette and builds the whole
+// table.  Call once from setup().
+/////////////////////////////////////////////////////
+void PaletteMorph::begin(uint8_t index) {
+  _index = index % numPalettes;
+  _current = _from = _to = matrixPaletteList[_index];
+  _changed = 0;
+  _frame = _nFrames = 0;
+  expandEntries(0xFFFF);
+}
+
+/////////////////////////////////////////////////////
+// Starts blending from whatever is showing now to the
+// palette at index, over nFrames frames
+/////////////////////////////////////////////////////
+void PaletteMorph::setTarget(uint8_t index, uint8_t nFrames) {
+  _index = index % numPalettes;
+  _from = _current;
+  _to = matrixPaletteList[_index];
+  _frame = 0;
+  _nFrames = max(nFrames, (uint8_t)1);
+  _elapsedMS = 0;
+
+  _changed = 0;
+  for (uint8_t i = 0; i < 16; i++) {
+    if (_from[i] != _to[i]) _changed |= (1 << i);
+  }
+  if (!_changed) _frame = _nFrames;
+}
+
+/////////////////////////////////////////////////////
+// Runs as many morph frames as are due
+/////////////////////////////////////////////////////
+boolean PaletteMorph::update(uint32_t dtMS) {
+  if (!morphing()) return false;
+
+  _elapsedMS += min(dtMS, (uint32_t)(PALETTE_MORPH_STEP_MS * _nFrames));
+  if (_elapsedMS < PALETTE_MORPH_STEP_MS) return false;
+  while (_elapsedMS >= PALETTE_MORPH_STEP_MS && morphing()) {
+    _elapsedMS -= PALETTE_MORPH_STEP_MS;
+    _frame++;
+  }
+  step();
+  return true;
+}
+
+/////////////////////////////////////////////////////
+// Sets the changing palette entries to their blend
+// for the current frame, then refreshes the table
+/////////////////////////////////////////////////////
+void PaletteMorph::step() {
+  fract8 f = morphing() ? ((uint16_t)_frame << 8) / _nFrames : 255;
+  for (uint8_t i = 0; i < 16; i++) {
+    if (!(_changed & (1 << i))) continue;
+    _current[i] = morphing() ? blend(_from[i], _to[i], f) : _to[i];
+  }
+  expandEntries(_changed);
+}
+
+/////////////////////////////////////////////////////
+// Rebuilds the table for the given palette entries.
+// Table entries 16*i..16*i+15 blend palette entry i
+// with entry i+1, so a change to entry i also affects
+// the block before it.
+/////////////////////////////////////////////////////
+void PaletteMorph::expandEntries(uint16_t entries) {
+  uint16_t blocks = entries | (entries >> 1) | (entries << 15);
+  for (uint8_t b = 0; b < 16; b++) {
+    if (!(blocks & (1 << b))) continue;
+    uint8_t start = b << 4;
+    for (uint8_t i = 0; i < 16; i++) {
+      _table[start + i] = ColorFromPalette(_current, start + i, 255, LINEARBLEND);
+    }
+  }
+}
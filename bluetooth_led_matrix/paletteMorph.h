@@ -0,0 +1,53 @@
+#ifndef __PALETTE_MORPH
+#define __PALETTE_MORPH
+
+#include <FastLED.h>
+
+// Palettes from FastLED library
+static CRGBPalette16 matrixPaletteList[] = {RainbowColors_p, CloudColors_p, PartyColors_p, OceanColors_p, LavaColors_p};
+static const int numPalettes = sizeof(matrixPaletteList)/sizeof(matrixPaletteList[0]);
+
+#define PALETTE_MORPH_FRAMES   50    // Frames to blend from one palette to the next
+#define PALETTE_MORPH_STEP_MS  20    // Time per frame, so a switch takes about a second
+
+///////////////////////////////////////////////////////////////////////
+//  Palette shared by all the effects.  Switching palettes blends the
+//  current palette toward the new one over a number of frames instead
+//  of jumping.  A 256 entry table of the (linearly blended) palette is
+//  kept so looking up a color is just an array read, and only the parts
+//  of the table next to palette entries that are changing get rebuilt.
+///////////////////////////////////////////////////////////////////////
+class PaletteMorph {
+
+public:
+  PaletteMorph() { _index = 0; _frame = 0; _nFrames = 0; _changed = 0; _elapsedMS = 0; };
+  void    begin(uint8_t index = 0);
+  void    next() { setTarget((_index + 1) % numPalettes); };
+  void    setTarget(uint8_t index, uint8_t nFrames = PALETTE_MORPH_FRAMES);
+  boolean update(uint32_t dtMS);   // Returns true if any colors changed
+  boolean morphing() { return _frame < _nFrames; };
+  uint8_t getIndex() { return _index; };
+  const CRGBPalette16& current() { return _current; };
+
+  // Same as ColorFromPalette(current(), index, brightness, LINEARBLEND), but from the table
+  CRGB color(uint8_t index, uint8_t brightness = 255) { 
+    CRGB c = _table[index];
+    if (brightness != 255) c.nscale8_video(brightness);
+    return c;
+  };
+
+private:
+  void    step();
+  void    expandEntries(uint16_t entries);
+
+  CRGBPalette16  _from, _to, _current;
+  CRGB           _table[256];
+  uint16_t       _changed;     // Bit per palette entry that differs between _from and _to
+  uint16_t       _elapsedMS;
+  uint8_t        _index;
+  uint8_t        _frame, _nFrames;
+};
+
+extern PaletteMorph matrixPalette;
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef __PANEL_MAP
+#define __PANEL_MAP
+
+#include <stdint.h>
+
+///////////////////////////////////////////////////////////////////////
+//  One panel in a chain of panels making up the canvas.  The panel's
+//  own first LED is its top left corner as wired, rows running along
+//  its width.  It is then mirrored left to right if asked, turned a
+//  number of quarter turns clockwise, and placed with its top left
+//  corner at (x, y) on the canvas.  Rotation and mirroring between them
+//  cover a first LED in any corner.
+///////////////////////////////////////////////////////////////////////
+struct PanelTile {
+  uint16_t  x, y;            // Where the panel's top left goes on the canvas
+  uint16_t  width, height;   // Panel size as wired, before rotating
+  uint8_t   rotation;        // Quarter turns clockwise, 0-3
+  bool      mirror;
+  bool      serpentine;      // Rows wired back and forth
+};
+
+///////////////////////////////////////////////////////////////////////
+//  For each LED in chain order, the canvas pixel (y * width + x) that
+//  it shows.  Effects draw on a plain row by row canvas and the output
+//  stage reads the canvas through this table, so all the wiring lives
+//  in one lookup per LED.
+///////////////////////////////////////////////////////////////////////
+template <uint16_t N_LEDS>
+struct PixelMap {
+  uint16_t index[N_LEDS];
+};
+
+// LEDs in a list of panels
+template <uint8_t N_TILES>
+constexpr uint32_t tileLeds(const PanelTile (&tiles)[N_TILES]) {
+  uint32_t n = 0;
+  for (uint8_t t = 0; t < N_TILES; t++) n += (uint32_t)tiles[t].width * tiles[t].height;
+  return n;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Builds the table at compile time for a canvas canvasWidth wide, with
+// the panels chained in the order they are listed.
+///////////////////////////////////////////////////////////////////////
+template <uint16_t N_LEDS, uint16_t canvasWidth, uint8_t N_TILES>
+constexpr PixelMap<N_LEDS> makePixelMap(const PanelTile (&tiles)[N_TILES]) {
+  PixelMap<N_LEDS> map = {};
+  uint16_t led = 0;
+  for (uint8_t t = 0; t < N_TILES; t++) {
+    const PanelTile &p = tiles[t];
+    for (uint16_t row = 0; row < p.height; row++) {
+      for (uint16_t i = 0; i < p.width; i++) {
+        uint16_t px = (p.serpentine && (row & 0x01)) ? p.width - 1 - i : i;
+        uint16_t py = row;
+        if (p.mirror) px = p.width - 1 - px;
+
+        uint16_t cx = px, cy = py;
+        switch (p.rotation & 3) {
+          case 1: cx = p.height - 1 - py; cy = px; break;
+          case 2: cx = p.width - 1 - px;  cy = p.height - 1 - py; break;
+          case 3: cx = py;                cy = p.width - 1 - px; break;
+        }
+        map.index[led++] = (uint32_t)(p.y + cy) * canvasWidth + p.x + cx;
+      }
+    }
+  }
+  return map;
+}
+
+///////////////////////////////////////////////////////////////////////
+// True if every panel, once rotated, lies inside a canvas canvasWidth x
+// canvasHeight and between them they light each canvas pixel exactly
+// once.  For the sketch's static_assert, so a panel list that would
+// send the output stage past the end of the frame doesn't build.
+///////////////////////////////////////////////////////////////////////
+template <uint16_t N_LEDS, uint16_t canvasWidth, uint16_t canvasHeight, uint8_t N_TILES>
+constexpr bool validPixelMap(const PanelTile (&tiles)[N_TILES]) {
+  if (tileLeds(tiles) != N_LEDS || (uint32_t)canvasWidth * canvasHeight != N_LEDS) return false;
+  for (uint8_t t = 0; t < N_TILES; t++) {
+    const PanelTile &p = tiles[t];
+    uint32_t w = (p.rotation & 1) ? p.height : p.width;
+    uint32_t h = (p.rotation & 1) ? p.width : p.height;
+    if (p.x + w > canvasWidth || p.y + h > canvasHeight) return false;
+  }
+
+  // All inside and the right number of LEDs, so no pixel twice means
+  // no pixel missed either
+  PixelMap<N_LEDS> map = makePixelMap<N_LEDS, canvasWidth>(tiles);
+  bool lit[N_LEDS] = {};
+  for (uint32_t i = 0; i < N_LEDS; i++) {
+    if (lit[map.index[i]]) return false;
+    lit[map.index[i]] = true;
+  }
+  return true;
+}
+
+#endif
@@ -0,0 +1,48 @@
+/////////////////////////////////////////////////////
+//  Functions for the ParticleSplat
+/////////////////////////////////////////////////////
+
+#include "particleSplat.h"
+#include "pixelBlend.h"
+
+///////////////////////////////////////////////////////////////////////
+// Splats n particles, given as separate x, y and color arrays.  They
+// are done SPLAT_BATCH at a time: first the corner weights and colors
+// of the whole batch are worked out, then they are all added to the
+// LEDs in one tight loop.
+///////////////////////////////////////////////////////////////////////
+void ParticleSplat::splat(CRGB *leds, const int32_t *x, const int32_t *y, const CRGB *colors, uint16_t n) {
+  uint16_t index[SPLAT_BATCH * 4];
+  uint32_t part[SPLAT_BATCH * 4];     // Packed share of the color for each LED
+
+  for (uint16_t first = 0; first < n; first += SPLAT_BATCH) {
+    uint8_t count = min(n - first, SPLAT_BATCH);
+    uint8_t nParts = 0;
+
+    for (uint8_t i = 0; i < count; i++) {
+      int32_t  col = x[first + i] >> SPLAT_SHIFT;    // Floors negative positions too
+      int32_t  row = y[first + i] >> SPLAT_SHIFT;
+      uint16_t fx = x[first + i] & (SPLAT_ONE - 1);
+      uint16_t fy = y[first + i] & (SPLAT_ONE - 1);
+      uint16_t w11 = (fx * fy) >> SPLAT_SHIFT;
+      uint16_t w[2][2] = { { (uint16_t)(SPLAT_ONE - fx - fy + w11), (uint16_t)(fx - w11) },   // Add up to exactly one
+                           { (uint16_t)(fy - w11), w11 } };
+      uint32_t color = packRGB(colors[first + i]);
+
+      for (uint8_t dy = 0; dy < 2; dy++) {
+        int32_t r = row + dy;
+        if (r < 0 || r >= _geom.height()) continue;
+        for (uint8_t dx = 0; dx < 2; dx++) {
+          int32_t  c = col + dx;
+          if (!w[dy][dx] || c < 0 || c >= _geom.width()) continue;
+          index[nParts] = _geom.XY(c, r);
+          part[nParts++] = scalePacked(color, w[dy][dx] - 1);   // Weights are 1 - 256
+        }
+      }
+    }
+
+    for (uint8_t i = 0; i < nParts; i++) {
+      leds[index[i]] = unpackRGB(addSaturatePacked(packRGB(leds[index[i]]), part[i]));
+    }
+  }
+}
@@ -0,0 +1,31 @@
+#ifndef __PARTICLE_SPLAT
+#define __PARTICLE_SPLAT
+
+#include <FastLED.h>
+#include "matrixGeometry.h"
+
+// Particle positions are 8.8 fixed point LED units, so 1 << SPLAT_SHIFT is
+// one LED.  A particle at (x, y) covers the LED sized square from x to x + 1.
+#define SPLAT_SHIFT   8
+#define SPLAT_ONE     (1 << SPLAT_SHIFT)
+#define SPLAT_BATCH   8    // Particles weighed before any pixel is written
+
+///////////////////////////////////////////////////////////////////////
+//  Draws particles between LEDs.  Each particle's color is shared by
+//  the four LEDs its square overlaps, weighted by how much of it each
+//  one covers, and added (saturating) to what is already there, so
+//  particles move smoothly and add up where they cross.  Anything off
+//  the matrix is dropped.  Shared by the particle style effects.
+///////////////////////////////////////////////////////////////////////
+class ParticleSplat {
+
+public:
+  ParticleSplat(uint16_t w, uint16_t h) { _geom.set(w, h); assert(_geom.matches(w, h)); };
+  void splat(CRGB *leds, int32_t x, int32_t y, CRGB color) { splat(leds, &x, &y, &color, 1); };
+  void splat(CRGB *leds, const int32_t *x, const int32_t *y, const CRGB *colors, uint16_t n);
+
+private:
+  MatrixGeometry  _geom;
+};
+
+#endif
@@ -0,0 +1,166 @@
+/////////////////////////////////////////////////////
+//  Functions for the ParticleSystem and renderers
+/////////////////////////////////////////////////////
+
+#include "particleSystem.h"
+#include "paletteMorph.h"
+
+ParticleSystem::ParticleSystem(uint16_t w, uint16_t h, const ParticleParams &params) : _params(params) {
+  _geom.set(w, h);
+  assert(_geom.matches(w, h));
+  #define PARTICLE_FIELD_NULL(type, name)  name = NULL;
+  PARTICLE_FIELDS(PARTICLE_FIELD_NULL)
+  _emitters = NULL;
+  _nEmitters = 0;
+  _count = 0;
+  _capacity = 0;
+  _driftDue = 0;
+}
+
+/////////////////////////////////////////////////////
+// Takes room for capacity particles from an effect's
+// scratch.  Returns false if there isn't enough.
+/////////////////////////////////////////////////////
+boolean ParticleSystem::claim(EffectScratch &scratch, uint16_t capacity) {
+  boolean fits = true;
+  #define PARTICLE_FIELD_CLAIM(type, name)  name = scratch.pool<type>(capacity); fits = fits && name;
+  PARTICLE_FIELDS(PARTICLE_FIELD_CLAIM)
+  if (!fits) life = NULL;     // So ready() is false, even if a smaller array after a failed one fitted
+  _capacity = ready() ? capacity : 0;
+  clear();
+  return ready();
+}
+
+void ParticleSystem::clear() {
+  _count = 0;
+  _driftDue = 0;
+  for (uint8_t e = 0; e < PARTICLE_MAX_EMITTERS; e++) {
+    _emitDue[e] = 0;
+    _nextColor[e] = (e < _nEmitters) ? _emitters[e].colorIndex : 0;
+  }
+}
+
+/////////////////////////////////////////////////////
+// Emitters run on every update().  The array is kept,
+// not copied, so effects can move them around.
+/////////////////////////////////////////////////////
+void ParticleSystem::setEmitters(const ParticleEmitter *emitters, uint8_t nEmitters) {
+  _emitters = emitters;
+  _nEmitters = min(nEmitters, PARTICLE_MAX_EMITTERS);
+  for (uint8_t e = 0; e < _nEmitters; e++) {
+    _emitDue[e] = 0;
+    _nextColor[e] = _emitters[e].colorIndex;
+  }
+}
+
+int16_t ParticleSystem::emit(const ParticleEmitter &emitter) {
+  if (_count >= _capacity) return -1;
+  uint16_t i = _count++;
+  x[i] = emitter.x;
+  y[i] = emitter.y;
+  vx[i] = constrain(emitter.vx + random(-emitter.spreadX, emitter.spreadX + 1), -PARTICLE_MAX_SPEED, PARTICLE_MAX_SPEED);
+  vy[i] = constrain(emitter.vy + random(-emitter.spreadY, emitter.spreadY + 1), -PARTICLE_MAX_SPEED, PARTICLE_MAX_SPEED);
+  age[i] = 0;
+  life[i] = emitter.lifeMS;
+  colorIndex[i] = emitter.colorIndex;
+  return i;
+}
+
+/////////////////////////////////////////////////////
+// Moves the last live particle into i's place
+/////////////////////////////////////////////////////
+void ParticleSystem::kill(uint16_t i) {
+  uint16_t last = --_count;
+  #define PARTICLE_FIELD_MOVE(type, name)  name[i] = name[last];
+  PARTICLE_FIELDS(PARTICLE_FIELD_MOVE)
+}
+
+/////////////////////////////////////////////////////
+// One time step.  dt is turned into 0.16 seconds once
+// so each particle's move is a multiply and a shift.
+// Bouncing walls are where a particle's square is
+// still fully on the matrix.  With WALLS_KILL a
+// particle goes once its square is all the way off.
+/////////////////////////////////////////////////////
+void ParticleSystem::update(uint32_t dtMS) {
+  if (!ready()) return;
+  uint16_t dt = min(dtMS, (uint32_t)0xFFFF);   // Effects pass one scheduler step
+
+  for (uint8_t e = 0; e < _nEmitters; e++) {
+    _emitDue[e] += (uint32_t)_emitters[e].ratePerSec * dt;
+    for (; _emitDue[e] >= 1000; _emitDue[e] -= 1000) {
+      int16_t i = emit(_emitters[e]);
+      if (i < 0) continue;
+      colorIndex[i] = _nextColor[e];
+      _nextColor[e] += _emitters[e].colorStep;
+    }
+  }
+
+  int32_t  dtSec = ((uint32_t)dt << 16) / 1000;
+  int32_t  dvx = (_params.gravityX * dtSec) >> 16;
+  int32_t  dvy = (_params.gravityY * dtSec) >> 16;
+  int32_t  maxX = (int32_t)(_geom.width() - 1) << SPLAT_SHIFT;
+  int32_t  maxY = (int32_t)(_geom.height() - 1) << SPLAT_SHIFT;
+  boolean  bounce = (_params.walls == WALLS_BOUNCE);
+  int32_t  minP = bounce ? 0 : 1 - SPLAT_ONE;
+  int32_t  over = bounce ? 0 : SPLAT_ONE - 1;     // How far past maxX or maxY a particle can go
+  int16_t  keep = (int16_t)_params.bounce + 1;    // Of 256
+
+  // Whole palette steps of drift due this update, the rest carried over
+  _driftDue += (int32_t)_params.colorDrift * dt;
+  int32_t  drift = _driftDue / 1000;
+  _driftDue -= drift * 1000;
+
+  for (uint16_t i = 0; i < _count; ) {
+    if (life[i]) {
+      age[i] = min((uint32_t)age[i] + dt, (uint32_t)life[i]);
+      if (age[i] >= life[i]) { kill(i); continue; }
+    }
+
+    int32_t v = constrain(vx[i] + dvx, -PARTICLE_MAX_SPEED, PARTICLE_MAX_SPEED);
+    int32_t p = x[i] + ((v * dtSec) >> 16);
+    if (p < minP || p > maxX + over) {
+      if (!bounce) { kill(i); continue; }
+      p = (p < 0) ? -p : 2 * maxX - p;
+      p = constrain(p, 0, maxX);
+      v = (-v * keep) >> 8;
+    }
+    x[i] = p;
+    vx[i] = v;
+
+    v = constrain(vy[i] + dvy, -PARTICLE_MAX_SPEED, PARTICLE_MAX_SPEED);
+    p = y[i] + ((v * dtSec) >> 16);
+    if (p < minP || p > maxY + over) {
+      if (!bounce) { kill(i); continue; }
+      p = (p < 0) ? -p : 2 * maxY - p;
+      p = constrain(p, 0, maxY);
+      v = (-v * keep) >> 8;
+    }
+    y[i] = p;
+    vy[i] = v;
+
+    colorIndex[i] += drift;
+    i++;
+  }
+}
+
+fract8 ParticleSystem::lifeLeft(uint16_t i) const {
+  if (!life[i]) return 255;
+  return 255 - ((uint32_t)age[i] * 255) / life[i];
+}
+
+///////////////////////////////////////////////////////////////////////
+// Palette colors are looked up SPLAT_BATCH particles at a time and
+// handed to the splat with the matching slice of the position arrays.
+///////////////////////////////////////////////////////////////////////
+void SplatParticleRenderer::render(const ParticleSystem &particles, CRGB *leds) {
+  CRGB colors[SPLAT_BATCH];
+  for (uint16_t first = 0; first < particles.count(); first += SPLAT_BATCH) {
+    uint8_t n = min(particles.count() - first, SPLAT_BATCH);
+    for (uint8_t i = 0; i < n; i++) {
+      uint8_t brightness = _fade ? scale8(_brightness, particles.lifeLeft(first + i)) : _brightness;
+      colors[i] = matrixPalette.color(particles.colorIndex[first + i], brightness);
+    }
+    _splat.splat(leds, particles.x + first, particles.y + first, colors, n);
+  }
+}
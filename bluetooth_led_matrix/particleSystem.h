@@ -0,0 +1,128 @@
+#ifndef __PARTICLE_SYSTEM
+#define __PARTICLE_SYSTEM
+
+#include <FastLED.h>
+#include "matrixGeometry.h"
+#include "effectScratch.h"
+#include "particleSplat.h"
+
+#define PARTICLE_MAX_EMITTERS  4
+#define PARTICLE_MAX_SPEED     0x7FFF   // 8.8 LEDs per second, about 128
+
+// The arrays each particle has a slot in, as FIELD(type, name).  claim(),
+// kill() and scratchBytes() all work from this list.
+#define PARTICLE_FIELDS(FIELD)   \
+  FIELD(int32_t,  x)             \
+  FIELD(int32_t,  y)             \
+  FIELD(int16_t,  vx)            \
+  FIELD(int16_t,  vy)            \
+  FIELD(uint16_t, age)           \
+  FIELD(uint8_t,  colorIndex)    \
+  FIELD(uint16_t, life)
+
+// Room an array takes, allowing for the worst padding in front of it
+#define PARTICLE_FIELD_BYTES(type, name)  + (uint32_t)capacity * sizeof(type) + alignof(type) - 1
+
+///////////////////////////////////////////////////////////////////////
+//  What happens to a particle that reaches the edge of the matrix
+///////////////////////////////////////////////////////////////////////
+enum ParticleWalls { WALLS_BOUNCE, WALLS_KILL };
+
+///////////////////////////////////////////////////////////////////////
+//  Physics shared by all the particles in a system.  Positions are 8.8
+//  fixed point LEDs, the same as ParticleSplat, and speeds are 8.8 LEDs
+//  per second.
+///////////////////////////////////////////////////////////////////////
+struct ParticleParams {
+  int16_t        gravityX, gravityY;   // 8.8 LEDs per second per second
+  ParticleWalls  walls;
+  fract8         bounce;               // Speed kept off a wall (WALLS_BOUNCE)
+  int8_t         colorDrift;           // Palette steps a second added to every color index
+};
+
+///////////////////////////////////////////////////////////////////////
+//  Makes new particles at a point, ratePerSec of them a second (or only
+//  when asked if 0).  Each gets the emitter's velocity plus a random
+//  amount up to +/- spread, and a palette index colorStep on from the
+//  last one.
+///////////////////////////////////////////////////////////////////////
+struct ParticleEmitter {
+  int32_t   x, y;               // 8.8 LEDs
+  int16_t   vx, vy;             // 8.8 LEDs per second
+  int16_t   spreadX, spreadY;
+  uint16_t  ratePerSec;
+  uint16_t  lifeMS;             // 0 = lives until it leaves the matrix
+  uint8_t   colorIndex;
+  uint8_t   colorStep;
+};
+
+///////////////////////////////////////////////////////////////////////
+//  Fixed size pool of particles kept as structure of arrays in an
+//  effect's scratch memory, so the update loop streams through each
+//  field and renderers can hand whole position arrays to the splat.
+//  Dead particles are swapped with the last live one, so the live ones
+//  are always 0 to count() - 1.
+///////////////////////////////////////////////////////////////////////
+class ParticleSystem {
+
+public:
+  ParticleSystem(uint16_t w, uint16_t h, const ParticleParams &params);
+  static constexpr uint32_t scratchBytes(uint16_t capacity) { return 0 PARTICLE_FIELDS(PARTICLE_FIELD_BYTES); };
+  boolean   claim(EffectScratch &scratch, uint16_t capacity);   // Needs scratchBytes(capacity)
+  boolean   ready() const { return life != NULL; };
+  void      clear();
+  void      setEmitters(const ParticleEmitter *emitters, uint8_t nEmitters);
+  int16_t   emit(const ParticleEmitter &emitter);   // Index of the new particle, -1 if the pool is full
+  void      update(uint32_t dtMS);                  // Emits, ages, moves and bounces
+
+  uint16_t  count() const { return _count; };
+  uint16_t  capacity() const { return _capacity; };
+  fract8    lifeLeft(uint16_t i) const;             // 255 when new (or immortal) down to 0
+
+  // Fields, for renderers and for effects that set particles up themselves.
+  // Positions are 8.8 LEDs, speeds 8.8 LEDs per second, ages and lives ms.
+  #define PARTICLE_FIELD_POINTER(type, name)  type *name;
+  PARTICLE_FIELDS(PARTICLE_FIELD_POINTER)
+
+private:
+  void      kill(uint16_t i);
+
+  MatrixGeometry          _geom;
+  const ParticleParams   &_params;
+  const ParticleEmitter  *_emitters;
+  uint8_t                 _nEmitters;
+  uint32_t                _emitDue[PARTICLE_MAX_EMITTERS];   // Particles owed, in 1/1000ths
+  uint8_t                 _nextColor[PARTICLE_MAX_EMITTERS];
+  int32_t                 _driftDue;                         // Color drift owed, in 1/1000ths
+  uint16_t                _count, _capacity;
+};
+
+///////////////////////////////////////////////////////////////////////
+//  Draws a ParticleSystem into an LED buffer.  Renderers only add to
+//  what's there, the effect clears the buffer first if it wants to.
+///////////////////////////////////////////////////////////////////////
+class ParticleRenderer {
+
+public:
+  virtual ~ParticleRenderer() {}
+  virtual void render(const ParticleSystem &particles, CRGB *leds) = 0;
+};
+
+///////////////////////////////////////////////////////////////////////
+//  Anti-aliased particles, optionally fading out over their lifetime
+///////////////////////////////////////////////////////////////////////
+class SplatParticleRenderer : public ParticleRenderer {
+
+public:
+  SplatParticleRenderer(uint16_t w, uint16_t h, uint8_t brightness = 255, boolean fade = false) : _splat(w, h) {
+    _brightness = brightness; _fade = fade;
+  };
+  void render(const ParticleSystem &particles, CRGB *leds);
+
+private:
+  ParticleSplat  _splat;
+  uint8_t        _brightness;
+  boolean        _fade;
+};
+
+#endif
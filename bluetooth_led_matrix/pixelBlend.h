@@ -0,0 +1,61 @@
+#ifndef __PIXEL_BLEND
+#define __PIXEL_BLEND
+
+///////////////////////////////////////////////////////////////////////
+//  Packed pixel blending kernels.  A CRGB is packed into the low three
+//  bytes of a 32 bit word (0x00RRGGBB) so all three channels can be
+//  blended with a couple of multiplies instead of one lerp per channel.
+///////////////////////////////////////////////////////////////////////
+#include <FastLED.h>
+
+static inline uint32_t packRGB(const CRGB &c) {
+  return ((uint32_t)c.r << 16) | ((uint32_t)c.g << 8) | c.b;
+}
+
+static inline CRGB unpackRGB(uint32_t p) {
+  return CRGB((p >> 16) & 0xFF, (p >> 8) & 0xFF, p & 0xFF);
+}
+
+///////////////////////////////////////////////////////////////////////
+// Blends from -> to by weight f (0 = all from, 255 = almost all to).
+// Red and blue share one multiply in separate 16 bit lanes, green gets
+// the other.  The weights add up to 256, so no lane can carry into its
+// neighbor and no saturation is needed.
+///////////////////////////////////////////////////////////////////////
+static inline uint32_t lerpPacked(uint32_t from, uint32_t to, fract8 f) {
+  uint32_t wTo   = f;
+  uint32_t wFrom = 256 - wTo;
+  uint32_t rb = ((from & 0xFF00FF) * wFrom + (to & 0xFF00FF) * wTo) >> 8;
+  uint32_t g  = ((from & 0x00FF00) * wFrom + (to & 0x00FF00) * wTo) >> 8;
+  return (rb & 0xFF00FF) | (g & 0x00FF00);
+}
+
+///////////////////////////////////////////////////////////////////////
+// Per-byte saturating add.  Uses the Cortex-M4 DSP UQADD8 instruction
+// on the Teensy 3.x, otherwise the usual carry-mask trick.
+///////////////////////////////////////////////////////////////////////
+static inline uint32_t addSaturatePacked(uint32_t a, uint32_t b) {
+#if defined(__ARM_ARCH_7EM__)
+  uint32_t r;
+  asm ("uqadd8 %0, %1, %2" : "=r" (r) : "r" (a), "r" (b));
+  return r;
+#else
+  uint32_t sum   = (a & 0x7F7F7F7F) + (b & 0x7F7F7F7F);
+  uint32_t carry = (a & b) | ((a | b) & sum);    // Carry out of bit 7 of each byte
+  carry &= 0x80808080;
+  uint32_t mask  = (carry << 1) - (carry >> 7);  // 0xFF in each overflowed byte
+  return (sum ^ ((a ^ b) & 0x80808080)) | mask;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////
+// Per-byte scale by f/256.  Same two-lane trick as lerpPacked.
+///////////////////////////////////////////////////////////////////////
+static inline uint32_t scalePacked(uint32_t p, fract8 f) {
+  uint32_t s  = (uint32_t)f + 1;
+  uint32_t rb = ((p & 0xFF00FF) * s) >> 8;
+  uint32_t g  = ((p & 0x00FF00) * s) >> 8;
+  return (rb & 0xFF00FF) | (g & 0x00FF00);
+}
+
+#endif
@@ -0,0 +1,76 @@
+/////////////////////////////////////////////////////
+//  Functions for the PowerLimiter
+/////////////////////////////////////////////////////
+
+#include "powerLimit.h"
+
+/////////////////////////////////////////////////////
+// Draw of one corrected pixel at full brightness, in
+// units of 1/255 mA.
+/////////////////////////////////////////////////////
+uint32_t PowerLimiter::pixelCost(const CRGB &c) {
+  return (uint32_t)_lut->r[c.r] * _model.redMA + _lut->g[c.g] * _model.greenMA + _lut->b[c.b] * _model.blueMA;
+}
+
+/////////////////////////////////////////////////////
+// Whole strip draw in mA at a global brightness,
+// scaled the same way the output stage scales it.
+/////////////////////////////////////////////////////
+uint32_t PowerLimiter::drawMA(uint8_t brightness) {
+  uint32_t lit  = (((uint64_t)_total * ((uint16_t)brightness + 1)) >> 8) / 255;
+  uint32_t idle = (uint32_t)_nLeds * _model.idleUA / 1000;
+  return lit + idle;
+}
+
+/////////////////////////////////////////////////////
+// Costs every pixel from scratch
+/////////////////////////////////////////////////////
+void PowerLimiter::recalculate(const CRGB *frame) {
+  _total = 0;
+  for (uint16_t i = 0; i < _nLeds; i++) {
+    _last[i] = frame[i];
+    _total += pixelCost(frame[i]);
+  }
+}
+
+/////////////////////////////////////////////////////
+// Brings the estimate up to date with the new frame
+// and works out the brightness to show it at.  Only
+// pixels that changed are costed again.
+/////////////////////////////////////////////////////
+uint8_t PowerLimiter::update(const CRGB *frame, const ColorLUT *lut, uint8_t brightness) {
+  if (lut != _lut) {
+    _lut = lut;
+    recalculate(frame);
+  } else {
+    for (uint16_t i = 0; i < _nLeds; i++) {
+      if (frame[i] != _last[i]) {
+        _total += pixelCost(frame[i]);
+        _total -= pixelCost(_last[i]);
+        _last[i] = frame[i];
+      }
+    }
+  }
+
+  // Highest brightness that fits in what's left after the idle draw
+  uint8_t  target = brightness;
+  uint32_t idle = (uint32_t)_nLeds * _model.idleUA / 1000;
+  if (_total) {
+    uint32_t spare = (_budgetMA > idle) ? _budgetMA - idle : 0;
+    uint64_t steps = (uint64_t)spare * 255 * 256 / _total;   // Allowed brightness + 1, 64 bit for big strips and budgets
+    if (steps <= brightness) {
+      target = steps ? steps - 1 : 0;
+    }
+  }
+
+  if (target < _limit) {
+    _limit = target;
+  } else if (target > _limit) {
+    _limit += max(1, (target - _limit) >> POWER_RECOVER_SHIFT);
+  }
+  if (_limit < brightness) _limitedFrames++;
+
+  _unlimitedMA = drawMA(brightness);
+  _estimatedMA = drawMA(_limit);
+  return _limit;
+}
@@ -0,0 +1,67 @@
+#ifndef __POWER_LIMIT
+#define __POWER_LIMIT
+
+#include <FastLED.h>
+#include "ledOutput.h"
+
+///////////////////////////////////////////////////////////////////////
+//  Current draw of one LED.  Each channel is given as its draw fully
+//  on at full brightness, and idle is what the chip takes when dark.
+///////////////////////////////////////////////////////////////////////
+struct PowerModel {
+  uint8_t   redMA;
+  uint8_t   greenMA;
+  uint8_t   blueMA;
+  uint16_t  idleUA;    // Microamps
+};
+
+// Typical figures for a 5050 APA102
+constexpr PowerModel apa102PowerModel = { 20, 20, 20, 700 };
+
+#define POWER_RECOVER_SHIFT  3   // Brightness climbs back 1/8 of the way each frame
+
+///////////////////////////////////////////////////////////////////////
+//  Estimates the current a frame will draw and picks a brightness that
+//  keeps it inside a budget.  The estimate is from the corrected
+//  values that actually drive the LEDs, so it goes through the same
+//  lookup table as the output stage.
+//
+//  A running total is kept and only pixels that differ from the last
+//  frame are re-costed, so a mostly still frame is just a compare per
+//  pixel.  Changing lookup tables costs the whole frame again.
+//
+//  When over budget the brightness drops straight to the limit, since
+//  a brown-out can't wait, then eases back up once the frame allows it.
+///////////////////////////////////////////////////////////////////////
+class PowerLimiter {
+
+public:
+  PowerLimiter(uint16_t nLeds, CRGB *lastFrame, uint32_t budgetMA, const PowerModel &model = apa102PowerModel) {
+    _nLeds = nLeds; _last = lastFrame; _budgetMA = budgetMA; _model = model;
+    _lut = NULL; _total = 0; _limit = 255; _unlimitedMA = 0; _estimatedMA = 0; _limitedFrames = 0;
+  };
+  void      setBudget(uint32_t budgetMA) { _budgetMA = budgetMA; };
+  uint32_t  getBudget() { return _budgetMA; };
+  uint8_t   update(const CRGB *frame, const ColorLUT *lut, uint8_t brightness);   // Returns the brightness to show at
+  uint8_t   limit() { return _limit; };                   // Brightness from the last update
+  uint32_t  estimatedMA() { return _estimatedMA; };       // Draw at that brightness
+  uint32_t  unlimitedMA() { return _unlimitedMA; };       // Draw at the brightness asked for
+  uint16_t  limitedFrames() { return _limitedFrames; };   // Frames that had to be turned down
+
+private:
+  uint32_t  pixelCost(const CRGB &c);
+  uint32_t  drawMA(uint8_t brightness);
+  void      recalculate(const CRGB *frame);
+
+  uint16_t         _nLeds;
+  CRGB            *_last;      // Frame the running total is for
+  const ColorLUT  *_lut;       // Table the running total is for
+  PowerModel       _model;
+  uint32_t         _total;     // Sum of pixelCost() over the frame, mA * 255 at full brightness
+  uint32_t         _budgetMA;
+  uint8_t          _limit;
+  uint32_t         _unlimitedMA, _estimatedMA;
+  uint16_t         _limitedFrames;
+};
+
+#endif
@@ -0,0 +1,81 @@
+/////////////////////////////////////////////////////
+//  Functions for the SuperCanvas
+/////////////////////////////////////////////////////
+
+#include "superCanvas.h"
+#include "pixelBlend.h"
+
+/////////////////////////////////////////////////////
+// Takes the canvas memory from an effect's scratch.
+// Returns false if there isn't room.
+/////////////////////////////////////////////////////
+boolean SuperCanvas::claim(EffectScratch &scratch, uint16_t w, uint16_t h, uint8_t scale) {
+  _shift = (scale >= 4) ? 2 : (scale >= 2) ? 1 : 0;
+  _width = w << _shift;
+  _height = h << _shift;
+  _pixels = scratch.pool<CRGB>((uint32_t)_width * _height);
+  return ready();
+}
+
+///////////////////////////////////////////////////////////////////////
+// Averages each scale x scale block of the canvas into its LED.  The
+// block is summed with red and blue in separate 16 bit lanes of one
+// word and green in another (16 subpixels of 255 can't overflow a
+// lane), then rounded and shifted down by log2 of the block area.
+///////////////////////////////////////////////////////////////////////
+void SuperCanvas::downsample(CRGB *leds, const MatrixGeometry &geom) const {
+  if (!ready()) return;
+  uint8_t   shift = _shift;
+  uint8_t   areaShift = 2 * shift;
+  uint32_t  half = (1UL << areaShift) >> 1;
+  uint32_t  rbRound = half | (half << 16);
+  uint32_t  gRound = half << 8;
+  uint16_t  stride = _width;
+
+  for (MatrixCoord y = 0; y < geom.height(); y++) {
+    const CRGB *block = _pixels + ((uint32_t)y << shift) * stride;
+    for (MatrixCoord x = 0; x < geom.width(); x++, block += (1 << shift)) {
+      uint32_t rb = rbRound, g = gRound;
+      const CRGB *p = block;
+      for (uint8_t j = 0; j < (1 << shift); j++, p += stride) {
+        for (uint8_t i = 0; i < (1 << shift); i++) {
+          uint32_t v = packRGB(p[i]);
+          rb += v & 0xFF00FF;
+          g  += v & 0x00FF00;
+        }
+      }
+      leds[geom.XY(x, y)] = unpackRGB(((rb >> areaShift) & 0xFF00FF) | ((g >> areaShift) & 0x00FF00));
+    }
+  }
+}
+
+/////////////////////////////////////////////////////
+// Trims a rectangle to the canvas.  False if nothing
+// is left of it.
+/////////////////////////////////////////////////////
+boolean SuperCanvas::clip(int16_t &x, int16_t &y, uint16_t &w, uint16_t &h) {
+  if (x < 0) { if (-x >= w) return false; w += x; x = 0; }
+  if (y < 0) { if (-y >= h) return false; h += y; y = 0; }
+  if (x >= _width || y >= _height) return false;
+  w = min(w, (uint16_t)(_width - x));
+  h = min(h, (uint16_t)(_height - y));
+  return w && h;
+}
+
+void SuperCanvas::addRect(int16_t x, int16_t y, uint16_t w, uint16_t h, CRGB color) {
+  if (!clip(x, y, w, h)) return;
+  uint32_t c = packRGB(color);
+  for (uint16_t j = 0; j < h; j++) {
+    CRGB *p = _pixels + (uint32_t)(y + j) * _width + x;
+    for (uint16_t i = 0; i < w; i++) {
+      p[i] = unpackRGB(addSaturatePacked(packRGB(p[i]), c));
+    }
+  }
+}
+
+void SuperCanvas::fillRect(int16_t x, int16_t y, uint16_t w, uint16_t h, CRGB color) {
+  if (!clip(x, y, w, h)) return;
+  for (uint16_t j = 0; j < h; j++) {
+    fill_solid(_pixels + (uint32_t)(y + j) * _width + x, w, color);
+  }
+}
@@ -0,0 +1,45 @@
+#ifndef __SUPER_CANVAS
+#define __SUPER_CANVAS
+
+#include <FastLED.h>
+#include "effectScratch.h"
+#include "matrixGeometry.h"
+
+// Default supersampling for effects that draw on a SuperCanvas (1, 2 or 4)
+#define SUPERSAMPLE_SCALE  2
+
+///////////////////////////////////////////////////////////////////////
+//  Drawing surface with scale x scale subpixels for every LED, kept in
+//  an effect's scratch memory.  Effects draw on it at the finer
+//  resolution and downsample() box filters it onto the LEDs, so
+//  something half way between two LEDs lights both at half brightness
+//  instead of jumping from one to the other.  Laid out row by row.
+///////////////////////////////////////////////////////////////////////
+class SuperCanvas {
+
+public:
+  SuperCanvas() { _pixels = NULL; _width = 0; _height = 0; _shift = 0; };
+  boolean   claim(EffectScratch &scratch, uint16_t w, uint16_t h, uint8_t scale = SUPERSAMPLE_SCALE);   // w, h in LEDs
+  static constexpr uint32_t scratchBytes(uint16_t w, uint16_t h, uint8_t scale = SUPERSAMPLE_SCALE) {
+    return (uint32_t)w * h * (scale >= 4 ? 16 : scale >= 2 ? 4 : 1) * sizeof(CRGB);   // Same rounding as claim()
+  };
+  boolean   ready() const { return _pixels != NULL; };
+  uint8_t   scale() const { return 1 << _shift; };
+  uint8_t   shift() const { return _shift; };
+  uint16_t  width() const { return _width; };     // In subpixels
+  uint16_t  height() const { return _height; };
+  const CRGB* pixels() const { return _pixels; };
+  void      clear() { fill_solid(_pixels, (uint32_t)_width * _height, CRGB::Black); };
+  void      addRect(int16_t x, int16_t y, uint16_t w, uint16_t h, CRGB color);   // Saturating add, clipped
+  void      fillRect(int16_t x, int16_t y, uint16_t w, uint16_t h, CRGB color);  // Clipped
+  void      downsample(CRGB *leds, const MatrixGeometry &geom) const;              // One LED per block
+
+private:
+  boolean   clip(int16_t &x, int16_t &y, uint16_t &w, uint16_t &h);
+
+  CRGB     *_pixels;
+  uint16_t  _width, _height;
+  uint8_t   _shift;     // log2 of the scale
+};
+
+#endif
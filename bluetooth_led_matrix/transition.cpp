@@ -0,0 +1,115 @@
+/////////////////////////////////////////////////////
+//  Functions for mode Transitions
+/////////////////////////////////////////////////////
+
+#include "transition.h"
+#include "pixelBlend.h"
+
+/////////////////////////////////////////////////////
+// Starts a transition.  The incoming effect should
+// already be initialized.
+/////////////////////////////////////////////////////
+void Transition::begin(DisplayMatrix *from, DisplayMatrix *to, TransitionType type, uint16_t durationMS) {
+  _from = from;
+  _to = to;
+  _type = type;
+  _durationMS = max(durationMS, (uint16_t)1);
+  _elapsedMS = 0;
+}
+
+/////////////////////////////////////////////////////
+// Runs both effects and moves the transition along
+/////////////////////////////////////////////////////
+boolean Transition::update(uint32_t dtMS) {
+  if (!active()) return false;
+
+  _from->update(dtMS);
+  _to->update(dtMS);
+
+  _elapsedMS = min((uint32_t)_elapsedMS + dtMS, (uint32_t)_durationMS);
+  if (_elapsedMS >= _durationMS) {
+    _from = NULL;
+    _to = NULL;
+    return false;
+  }
+  return true;
+}
+
+/////////////////////////////////////////////////////
+// Blends the two effect layers into out
+/////////////////////////////////////////////////////
+void Transition::render(CRGB *out) {
+  if (!active()) return;
+
+  const CRGB *from = _from->getLeds();
+  const CRGB *to   = _to->getLeds();
+  uint16_t    nLeds = _geom.nLeds();
+  fract8      progress = ((uint32_t)_elapsedMS << 8) / _durationMS;
+
+  switch (_type) {
+    case TRANSITION_CROSSFADE:
+      for (uint16_t i = 0; i < nLeds; i++) {
+        out[i] = unpackRGB(lerpPacked(packRGB(from[i]), packRGB(to[i]), progress));
+      }
+      break;
+
+    case TRANSITION_DISSOLVE:
+      // Each pixel switches when progress passes its own scattered threshold
+      for (uint16_t i = 0; i < nLeds; i++) {
+        uint8_t threshold = (uint8_t)((i * 2654435761UL) >> 24);
+        out[i] = (progress > threshold) ? to[i] : from[i];
+      }
+      break;
+
+    case TRANSITION_WIPE:
+      renderWipe(from, to, out);
+      break;
+
+    case TRANSITION_PUSH:
+      renderPush(from, to, out);
+      break;
+
+    default:
+      break;
+  }
+}
+
+/////////////////////////////////////////////////////
+// Columns left of the edge show the new effect. The
+// column the edge is in gets a blend of both.
+/////////////////////////////////////////////////////
+void Transition::renderWipe(const CRGB *from, const CRGB *to, CRGB *out) {
+  uint32_t edge  = ((uint64_t)_elapsedMS * _geom.width() << 8) / _durationMS;  // 8.8 columns
+  uint16_t col   = edge >> 8;
+  fract8   fract = edge & 0xFF;
+
+  for (MatrixCoord x = 0; x < _geom.width(); x++) {
+    for (MatrixCoord y = 0; y < _geom.height(); y++) {
+      uint16_t i = _geom.XY(x, y);
+      if (x < col)       out[i] = to[i];
+      else if (x > col)  out[i] = from[i];
+      else               out[i] = unpackRGB(lerpPacked(packRGB(from[i]), packRGB(to[i]), fract));
+    }
+  }
+}
+
+/////////////////////////////////////////////////////
+// Treats the two effects as one strip twice as wide
+// (old on the left, new on the right) and scrolls it
+// left by a fractional number of columns.
+/////////////////////////////////////////////////////
+void Transition::renderPush(const CRGB *from, const CRGB *to, CRGB *out) {
+  uint32_t offset = ((uint64_t)_elapsedMS * _geom.width() << 8) / _durationMS;  // 8.8 columns
+  uint16_t shift  = offset >> 8;
+  fract8   fract  = offset & 0xFF;
+
+  for (MatrixCoord x = 0; x < _geom.width(); x++) {
+    uint16_t v = x + shift;       // Column in the double-wide strip
+    uint16_t n = v + 1;
+    for (MatrixCoord y = 0; y < _geom.height(); y++) {
+      CRGB cur  = (v < _geom.width()) ? from[_geom.XY(v, y)] : to[_geom.XY(v - _geom.width(), y)];
+      CRGB next = (n < _geom.width()) ? from[_geom.XY(n, y)] : to[_geom.XY(min(n - _geom.width(), _geom.width() - 1), y)];
+      out[_geom.XY(x, y)] = unpackRGB(lerpPacked(packRGB(cur), packRGB(next), fract));
+    }
+  }
+}
@@ -0,0 +1,42 @@
+#ifndef __TRANSITION
+#define __TRANSITION
+
+#include <FastLED.h>
+#include "displayClass.h"
+
+///////////////////////////////////////////////////////////////////////
+//  Ways of getting from one effect to the next:
+//    CROSSFADE - old effect fades out while the new one fades in
+//    WIPE      - new effect is uncovered from left to right
+//    DISSOLVE  - pixels switch over one at a time in a scattered order
+//    PUSH      - new effect slides in from the right, pushing the old out
+///////////////////////////////////////////////////////////////////////
+enum TransitionType { TRANSITION_CROSSFADE, TRANSITION_WIPE, TRANSITION_DISSOLVE, TRANSITION_PUSH, NUM_TRANSITIONS };
+
+///////////////////////////////////////////////////////////////////////
+//  Runs an outgoing and an incoming effect side by side for a set time
+//  and blends their layers.  Both effects must be drawing into their
+//  own buffers.
+///////////////////////////////////////////////////////////////////////
+class Transition {
+
+public:
+  Transition(uint16_t w, uint16_t h) { _geom.set(w, h); assert(_geom.matches(w, h)); _from = NULL; _to = NULL; };
+  void    begin(DisplayMatrix *from, DisplayMatrix *to, TransitionType type, uint16_t durationMS);
+  boolean active() { return _to != NULL; };
+  boolean update(uint32_t dtMS);   // Returns false once the transition has finished
+  void    render(CRGB *out);
+
+private:
+  void    renderWipe(const CRGB *from, const CRGB *to, CRGB *out);
+  void    renderPush(const CRGB *from, const CRGB *to, CRGB *out);
+
+  DisplayMatrix  *_from;
+  DisplayMatrix  *_to;
+  TransitionType  _type;
+  uint16_t        _durationMS;
+  uint16_t        _elapsedMS;
+  MatrixGeometry  _geom;
+};
+
+#endif
@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+#
+#  Pulls LED positions out of a layout drawing and writes them as a
+#  coordinate table for the firmware (see bluetooth_led_matrix/ledSpace.h).
+#
+#  Every LED is a circle, ellipse, Inkscape arc or rectangle whose id or
+#  Inkscape label is "led" followed by its position in the chain, e.g.
+#  led0, led1, ...  Their centers, after all transforms, are scaled to
+#  0-255 on the longer side (keeping the aspect ratio) so each LED is
+#  two bytes.
+#
+#  Usage:  svgToLedCoords.py BagLayout.svg -o ../bluetooth_led_matrix/ledCoords.h
+#
+import argparse
+import math
+import re
+import sys
+import xml.etree.ElementTree as ET
+
+SVG = '{http://www.w3.org/2000/svg}'
+INKSCAPE = '{http://www.inkscape.org/namespaces/inkscape}'
+SODIPODI = '{http://sodipodi.sourceforge.net/DTD/sodipodi-0.dtd}'
+
+LED_NAME = re.compile(r'^led[-_ ]?(\d+)$', re.IGNORECASE)
+
+
+def multiply(a, b):
+    # Affine matrices as (a, b, c, d, e, f), same order as SVG matrix()
+    return (a[0]*b[0] + a[2]*b[1],          a[1]*b[0] + a[3]*b[1],
+            a[0]*b[2] + a[2]*b[3],          a[1]*b[2] + a[3]*b[3],
+            a[0]*b[4] + a[2]*b[5] + a[4],   a[1]*b[4] + a[3]*b[5] + a[5])
+
+
+def parse_transform(text):
+    m = (1, 0, 0, 1, 0, 0)
+    if not text:
+        return m
+    for name, args in re.findall(r'(\w+)\s*\(([^)]*)\)', text):
+        v = [float(n) for n in re.split(r'[\s,]+', args.strip()) if n]
+        if name == 'matrix':
+            t = tuple(v)
+        elif name == 'translate':
+            t = (1, 0, 0, 1, v[0], v[1] if len(v) > 1 else 0)
+        elif name == 'scale':
+            t = (v[0], 0, 0, v[1] if len(v) > 1 else v[0], 0, 0)
+        elif name == 'rotate':
+            r = math.radians(v[0])
+            t = (math.cos(r), math.sin(r), -math.sin(r), math.cos(r), 0, 0)
+            if len(v) == 3:
+                t = multiply(multiply((1, 0, 0, 1, v[1], v[2]), t), (1, 0, 0, 1, -v[1], -v[2]))
+        elif name == 'skewX':
+            t = (1, 0, math.tan(math.radians(v[0])), 1, 0, 0)
+        elif name == 'skewY':
+            t = (1, math.tan(math.radians(v[0])), 0, 1, 0, 0)
+        else:
+            raise ValueError('unknown transform ' + name)
+        m = multiply(m, t)
+    return m
+
+
+def center(el):
+    tag = el.tag.replace(SVG, '')
+    if tag in ('circle', 'ellipse'):
+        return float(el.get('cx', 0)), float(el.get('cy', 0))
+    if tag == 'rect':
+        return (float(el.get('x', 0)) + float(el.get('width', 0)) / 2,
+                float(el.get('y', 0)) + float(el.get('height', 0)) / 2)
+    if tag == 'path' and el.get(SODIPODI + 'cx') is not None:
+        return float(el.get(SODIPODI + 'cx')), float(el.get(SODIPODI + 'cy'))
+    return None
+
+
+def find_leds(el, m, leds):
+    m = multiply(m, parse_transform(el.get('transform')))
+    name = el.get(INKSCAPE + 'label') or el.get('id') or ''
+    match = LED_NAME.match(name)
+    if match:
+        c = center(el)
+        if c is None:
+            raise ValueError('%s is not a shape with a center' % name)
+        index = int(match.group(1))
+        if index in leds:
+            raise ValueError('led%d appears twice' % index)
+        leds[index] = (m[0]*c[0] + m[2]*c[1] + m[4], m[1]*c[0] + m[3]*c[1] + m[5])
+    for child in el:
+        find_leds(child, m, leds)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Make an LED coordinate table from a layout SVG')
+    parser.add_argument('svg')
+    parser.add_argument('-o', '--output', help='header to write (default stdout)')
+    parser.add_argument('-n', '--name', default='ledCoords', help='name of the table')
+    args = parser.parse_args()
+
+    leds = {}
+    find_leds(ET.parse(args.svg).getroot(), (1, 0, 0, 1, 0, 0), leds)
+    if not leds:
+        sys.exit('%s: no shapes named led0, led1, ...' % args.svg)
+    missing = [i for i in range(max(leds) + 1) if i not in leds]
+    if missing:
+        sys.exit('%s: no LED numbered %s' % (args.svg, ', '.join(map(str, missing))))
+
+    xs = [leds[i][0] for i in sorted(leds)]
+    ys = [leds[i][1] for i in sorted(leds)]
+    span = max(max(xs) - min(xs), max(ys) - min(ys)) or 1
+    scale = 255 / span
+    coords = [(round((x - min(xs)) * scale), round((y - min(ys)) * scale)) for x, y in zip(xs, ys)]
+
+    macro = re.sub(r'([a-z])([A-Z])', r'\1_\2', args.name).upper()
+    out = ['// Generated from %s by design/svgToLedCoords.py, don\'t edit' % args.svg.split('/')[-1],
+           '#ifndef __%s' % macro,
+           '#define __%s' % macro,
+           '',
+           '#include "ledSpace.h"',
+           '',
+           '#define %s_COUNT  %d' % (macro, len(coords)),
+           '',
+           'const LedCoord %s[] = {' % args.name]
+    for i in range(0, len(coords), 8):
+        out.append('  ' + ' '.join('{%3d,%3d},' % c for c in coords[i:i + 8]))
+    out += ['};', '', '#endif', '']
+
+    text = '\n'.join(out)
+    if args.output:
+        with open(args.output, 'w') as f:
+            f.write(text)
+    else:
+        sys.stdout.write(text)
+
+
+if __name__ == '__main__':
+    main()
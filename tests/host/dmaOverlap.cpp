@@ -0,0 +1,68 @@
+///////////////////////////////////////////////////////////////////////
+//  How much of the APA102 transfer double-buffered DMA output hides
+//  behind drawing.  Off the Teensy busy() follows transferMicros() on
+//  the real clock, so this measures the model, not the hardware: the
+//  on-board figure is what !stats reports from stallMicros().
+//
+//  Drawing is a busy wait of a quarter, half, one and two transfer
+//  times.  The blocking run waits for each transfer before drawing the
+//  next frame, the overlapped run only waits when show() has to.
+///////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <vector>
+#include "ledOutput.h"
+
+static const uint16_t sizes[] = { 60, 1024, 4096 };
+
+static void draw(unsigned long us) {
+  unsigned long end = micros() + us;
+  while ((long)(end - micros()) > 0) ;
+}
+
+int main() {
+  int failures = 0;
+  printf("Microseconds per frame, blocking and overlapped\n\n");
+  printf("   LEDs  transfer   draw  blocking  overlapped   gain  waited/frame\n");
+
+  for (uint16_t n : sizes) {
+    std::vector<CRGB>     leds(n), frame(n);
+    std::vector<uint16_t> map(n);
+    std::vector<uint8_t>  front(APA102_FRAME_BYTES(n)), back(APA102_FRAME_BYTES(n));
+    for (uint16_t i = 0; i < n; i++) {
+      map[i] = i;
+      frame[i] = CRGB(random(256), random(256), random(256));
+    }
+
+    unsigned long transfer = LedOutput::transferMicros(APA102_FRAME_BYTES(n));
+    uint32_t      frames = max(200000UL / transfer, 20UL);
+    for (unsigned long drawMicros : { transfer / 4, transfer / 2, transfer, 2 * transfer }) {
+      double   period[2];
+      uint32_t waited = 0;
+      for (uint8_t overlap = 0; overlap < 2; overlap++) {
+        LedOutput out(leds.data(), n, map.data());
+        out.enableApa102Dma(front.data(), back.data());
+        unsigned long start = micros();
+        for (uint32_t f = 0; f < frames; f++) {
+          draw(drawMicros);
+          out.show(frame.data());
+          if (!overlap) while (out.busy()) ;
+        }
+        while (out.busy()) ;
+        period[overlap] = (double)(micros() - start) / frames;
+        if (overlap) waited = out.stallMicros();
+      }
+
+      double gain = 100 * (period[0] - period[1]) / period[0];
+      printf("%7u %7luus %5luus %8.0fus %9.0fus %5.1f%% %11.0fus", n, transfer, drawMicros, period[0], period[1], gain, (double)waited / frames);
+      if (period[1] >= period[0]) {
+        printf("  <- no overlap");
+        failures++;
+      }
+      printf("\n");
+    }
+  }
+
+  if (failures) printf("\n%d check(s) failed\n", failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,76 @@
+///////////////////////////////////////////////////////////////////////
+//  Checks SuperCanvas::downsample() against a plain per channel
+//  average at scales 1, 2 and 4, and times it.  Random canvases, each
+//  LED has to come out as the rounded mean of its block exactly.  Like
+//  geometrySweep, a fixed geometry build runs just its own size.
+///////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+#include "superCanvas.h"
+
+struct BenchSize { uint16_t w, h; };
+#ifdef MATRIX_RUNTIME_GEOMETRY
+static const BenchSize sizes[] = { {10, 6}, {32, 32}, {128, 128} };
+#else
+static const BenchSize sizes[] = { {MATRIX_WIDTH, MATRIX_HEIGHT} };
+#endif
+
+int main() {
+  int failures = 0;
+  printf("Microseconds per downsample\n\n");
+  printf("   size    LEDs       x1       x2       x4\n");
+
+  for (const BenchSize &s : sizes) {
+    uint32_t n = (uint32_t)s.w * s.h;
+    std::vector<uint8_t> mem(n * 4 * 4 * sizeof(CRGB));
+    std::vector<CRGB> leds(n);
+    MatrixGeometry geom;
+    geom.set(s.w, s.h);
+    assert(geom.matches(s.w, s.h));
+    printf("%3ux%-3u %7u", s.w, s.h, n);
+
+    for (uint8_t scale = 1; scale <= 4; scale <<= 1) {
+      EffectScratch scratch(mem.data(), mem.size());
+      scratch.reset();
+      SuperCanvas canvas;
+      canvas.claim(scratch, s.w, s.h, scale);
+      CRGB *sub = (CRGB *)mem.data();
+      uint32_t nSub = (uint32_t)canvas.width() * canvas.height();
+
+      // Correctness
+      uint32_t wrong = 0;
+      for (uint8_t trial = 0; trial < 20; trial++) {
+        for (uint32_t i = 0; i < nSub; i++) sub[i] = CRGB(random(256), random(256), random(256));
+        canvas.downsample(leds.data(), geom);
+        for (uint16_t y = 0; y < s.h; y++) {
+          for (uint16_t x = 0; x < s.w; x++) {
+            for (uint8_t ch = 0; ch < 3; ch++) {
+              uint32_t sum = 0;
+              for (uint8_t j = 0; j < scale; j++) {
+                for (uint8_t i = 0; i < scale; i++) sum += sub[(uint32_t)(y * scale + j) * canvas.width() + x * scale + i][ch];
+              }
+              if (leds[geom.XY(x, y)][ch] != (sum + scale * scale / 2) / (scale * scale)) wrong++;
+            }
+          }
+        }
+      }
+      if (wrong) failures++;
+
+      // Speed
+      uint32_t reps = max(2000000 / nSub, 10U);
+      auto start = std::chrono::steady_clock::now();
+      for (uint32_t r = 0; r < reps; r++) {
+        canvas.downsample(leds.data(), geom);
+        asm volatile("" : : "r"(leds.data()) : "memory");   // Keep every pass
+      }
+      printf(" %8.2f", std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / reps);
+      if (wrong) printf(" (%u wrong)", wrong);
+    }
+    printf("\n");
+  }
+
+  if (failures) printf("\n%d scale(s) didn't match the reference\n", failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,192 @@
+///////////////////////////////////////////////////////////////////////
+//  Runs every background effect and transition across matrix sizes and
+//  reports the time per frame.  Built with MATRIX_RUNTIME_GEOMETRY it
+//  sweeps 10x6 (60 LEDs) up to 128x128 (16,384).  Built with a fixed
+//  MATRIX_WIDTH and MATRIX_HEIGHT it runs just that size, with the
+//  compact types the firmware would get.
+//
+//  Besides the address and undefined behavior sanitizers in the check
+//  build, each size checks that:
+//    - every effect gets all its scratch from exactly its scratchBytes()
+//    - XYsafe() refuses every edge just off the matrix
+//    - snakeXY() visits every pixel exactly once
+//    - the worm stays its full length and reaches both ends without
+//      wrapping
+//    - the fountain sprays from the bottom quarter up out of it
+//    - rain comes in at the top and falls out of the bottom
+///////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+#include "transition.h"
+
+#define FRAME_MS  10    // Same as the sketch's FRAME_INTERVAL_MS
+
+struct SweepSize { uint16_t w, h; };
+
+#ifdef MATRIX_RUNTIME_GEOMETRY
+static const SweepSize sizes[] = { {10, 6}, {17, 15}, {16, 16}, {300, 4}, {4, 300}, {32, 32}, {64, 64}, {128, 128} };
+#else
+static const SweepSize sizes[] = { {MATRIX_WIDTH, MATRIX_HEIGHT} };
+#endif
+
+static int failures = 0;
+
+static void fail(const SweepSize &s, const char *what) {
+  printf("\n  %ux%u: %s", s.w, s.h, what);
+  failures++;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Activates an effect the way the arena does, but with only the scratch
+// memory it says it needs, so a short scratchBytes() fails the claim
+// (or trips the address sanitizer)
+///////////////////////////////////////////////////////////////////////
+template <typename T>
+static void activate(const SweepSize &s, T &effect, std::vector<uint8_t> &mem) {
+  mem.assign(max(T::scratchBytes(s.w, s.h), 1U), 0);    // The arena's is never empty either
+  EffectScratch scratch(mem.data(), mem.size());
+  scratch.reset();
+  if (!effect.claimScratch(scratch)) fail(s, "an effect needs more scratch than its scratchBytes()");
+  effect.init();
+}
+
+///////////////////////////////////////////////////////////////////////
+// Microseconds per frame for one effect
+///////////////////////////////////////////////////////////////////////
+template <typename T>
+static double timeEffect(const SweepSize &s, T &effect, std::vector<uint8_t> &mem, uint32_t frames) {
+  activate(s, effect, mem);
+
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t f = 0; f < frames; f++) effect.update(FRAME_MS);
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / frames;
+}
+
+static uint16_t litPixels(const CRGB *leds, uint32_t n) {
+  uint16_t lit = 0;
+  for (uint32_t i = 0; i < n; i++) if (leds[i]) lit++;
+  return lit;
+}
+
+///////////////////////////////////////////////////////////////////////
+// The worm is 7 pixels, so one step at a time it must show all 7 and
+// get to both the first and last pixel of its path
+///////////////////////////////////////////////////////////////////////
+static void checkWorm(const SweepSize &s, Worm &worm, CRGB *leds) {
+  uint32_t n = (uint32_t)s.w * s.h;
+  uint16_t first = worm.snakeXY(0), last = worm.snakeXY(n - 1);
+  boolean  sawFirst = false, sawLast = false;
+
+  fill_solid(leds, n, CRGB::Black);
+  worm.init();
+  for (uint32_t step = 0; step < 2 * n + 10; step++) {
+    worm.update(worm.scheduler().getStep());
+    if (litPixels(leds, n) != 7) { fail(s, "worm isn't 7 pixels long"); return; }
+    sawFirst |= (boolean)leds[first];
+    sawLast |= (boolean)leds[last];
+  }
+  if (!sawFirst || !sawLast) fail(s, "worm didn't reach both ends");
+}
+
+static void checkFountain(const SweepSize &s, Fountain &fountain, CRGB *leds, std::vector<uint8_t> &mem) {
+  activate(s, fountain, mem);
+
+  // The canvas is row by row from the top
+  uint32_t n = (uint32_t)s.w * s.h;
+  uint32_t bottomQuarter = (uint32_t)s.w * (s.h - max(s.h / 4, 1));
+  boolean  sawLow = false, sawHigh = false;
+  for (uint16_t f = 0; f < 300; f++) {
+    fountain.update(FRAME_MS);
+    for (uint32_t i = 0; i < bottomQuarter; i++) sawHigh |= (boolean)leds[i];
+    for (uint32_t i = bottomQuarter; i < n; i++) sawLow |= (boolean)leds[i];
+  }
+  if (!sawLow || !sawHigh) fail(s, "fountain doesn't spray up from the bottom");
+}
+
+static void checkRain(const SweepSize &s, DisplayRain &rain, CRGB *leds, std::vector<uint8_t> &mem) {
+  activate(s, rain, mem);
+
+  uint32_t n = (uint32_t)s.w * s.h;
+  boolean  sawTop = false, sawBottom = false;
+  // The slowest drops fall 6 rows a second
+  for (uint32_t f = 0; f < 100 + (uint32_t)(1000 / 6 / FRAME_MS) * s.h; f++) {
+    rain.update(FRAME_MS);
+    for (uint16_t x = 0; x < s.w; x++) {
+      sawTop |= (boolean)leds[x];
+      sawBottom |= (boolean)leds[n - s.w + x];
+    }
+  }
+  if (!sawTop || !sawBottom) fail(s, "rain doesn't fall from the top to the bottom");
+}
+
+static void checkIndexing(const SweepSize &s, DisplayMatrix &effect) {
+  uint32_t n = (uint32_t)s.w * s.h;
+  if (effect.XYsafe(s.w, 0) != -1 || effect.XYsafe(0, s.h) != -1 || effect.XYsafe(-1, 0) != -1 || effect.XYsafe(0, -1) != -1)
+    fail(s, "XYsafe() let an off-matrix pixel through");
+  if (effect.XYsafe(s.w - 1, s.h - 1) != (int32_t)(n - 1)) fail(s, "XYsafe() lost the last pixel");
+
+  std::vector<uint8_t> seen(n, 0);
+  for (uint32_t i = 0; i < n; i++) seen[effect.snakeXY(i)]++;
+  for (uint32_t i = 0; i < n; i++) {
+    if (seen[i] != 1) { fail(s, "snakeXY() doesn't visit every pixel once"); break; }
+  }
+}
+
+int main() {
+  matrixPalette.begin();
+  printf("Microseconds per %d ms frame (coord/index = bytes in MatrixCoord/MatrixIndex)\n\n", FRAME_MS);
+  printf("   size    LEDs coord/index     worm    lines     life  twinkle     rain   bounce fountain  transition\n");
+
+  for (const SweepSize &s : sizes) {
+    uint32_t n = (uint32_t)s.w * s.h;
+    uint32_t frames = constrain(200000 / n, 20UL, 2000UL);
+
+    // Each layer has the safety pixel in front, like the sketch's
+    std::vector<CRGB> layerA(n + 1, CRGB::Black), layerB(n + 1, CRGB::Black), out(n + 1, CRGB::Black);
+    CRGB *a = layerA.data() + 1, *b = layerB.data() + 1;
+    std::vector<uint8_t> mem[2];
+
+    Worm            worm(a, s.w, s.h);
+    Lines           lines(a, s.w, s.h);
+    GameOfLife      life(a, s.w, s.h);
+    Twinkle         twinkle(a, s.w, s.h);
+    DisplayRain     rain(a, s.w, s.h);
+    BouncingPixels  bounce(a, s.w, s.h);
+    Fountain        fountain(a, s.w, s.h);
+
+    printf("%3ux%-3u %7u       %u/%u    ", s.w, s.h, n, (unsigned)sizeof(MatrixCoord), (unsigned)sizeof(MatrixIndex));
+    printf(" %8.2f", timeEffect(s, worm, mem[0], frames));
+    printf(" %8.2f", timeEffect(s, lines, mem[0], frames));
+    printf(" %8.2f", timeEffect(s, life, mem[0], frames));
+    printf(" %8.2f", timeEffect(s, twinkle, mem[0], frames));
+    printf(" %8.2f", timeEffect(s, rain, mem[0], frames));
+    printf(" %8.2f", timeEffect(s, bounce, mem[0], frames));
+    printf(" %8.2f", timeEffect(s, fountain, mem[0], frames));
+
+    // Every transition type in turn, with the effects on both sides running
+    Lines      incoming(b, s.w, s.h);
+    Transition transition(s.w, s.h);
+    activate(s, incoming, mem[1]);
+    uint32_t renders = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint8_t type = 0; type < NUM_TRANSITIONS; type++) {
+      transition.begin(&fountain, &incoming, (TransitionType)type, 20 * FRAME_MS);
+      while (transition.update(FRAME_MS)) {
+        transition.render(out.data() + 1);
+        renders++;
+      }
+    }
+    printf(" %11.2f", std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / renders);
+
+    checkIndexing(s, worm);
+    checkWorm(s, worm, a);
+    checkFountain(s, fountain, a, mem[0]);
+    checkRain(s, rain, a, mem[0]);
+    printf("\n");
+  }
+
+  if (failures) printf("\n%d check(s) failed\n", failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,79 @@
+///////////////////////////////////////////////////////////////////////
+//  Measures how many buffer bytes LedOutput::show() writes per frame
+//  for each output path, and checks bytesWritten() against it.
+//
+//  show() runs twice on the same frame.  Before each run every buffer
+//  the output stage owns (LEDs, dither targets and errors, APA102
+//  transmit buffer) is filled, with 0x00 the first time and 0xFF the
+//  second.  A byte counts as written if it changed in either run.  A
+//  byte written with the value it already held in both runs is missed,
+//  so the measurement can come in a little under the real count but
+//  never over it.
+///////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "ledOutput.h"
+
+enum OutputPath { PATH_DIRECT, PATH_DITHER, PATH_PLAIN, NUM_PATHS };
+static const char *pathNames[] = { "direct", "dither", "plain" };
+
+static const uint16_t sizes[] = { 60, 256, 1024, 4096 };
+
+int main() {
+  int failures = 0;
+  printf("Buffer bytes written per frame\n\n");
+  printf("  path    LEDs  measured  bytesWritten()\n");
+
+  for (uint8_t path = 0; path < NUM_PATHS; path++) {
+    for (uint16_t n : sizes) {
+      std::vector<CRGB>     leds(n), frame(n);
+      std::vector<uint16_t> map(n), target(3 * n);
+      std::vector<uint8_t>  error(3 * n), tx(APA102_FRAME_BYTES(n));
+      for (uint16_t i = 0; i < n; i++) {
+        map[i] = i;
+        frame[i] = CRGB(random(256), random(256), random(256));
+      }
+
+      uint8_t *buffers[] = { (uint8_t *)leds.data(), (uint8_t *)target.data(), error.data(), tx.data() };
+      size_t   bytes[] = { leds.size() * sizeof(CRGB), target.size() * sizeof(uint16_t), error.size(), tx.size() };
+      std::vector<bool> changed;
+      uint32_t reported = 0;
+
+      for (uint8_t pass = 0; pass < 2; pass++) {
+        LedOutput out(leds.data(), n, map.data());
+        if (path == PATH_DIRECT) out.enableApa102(4, 5, tx.data());
+        if (path == PATH_DITHER) out.enableDither(target.data(), error.data());
+        out.setBrightness(100);
+
+        uint8_t fill = pass ? 0xFF : 0x00;
+        for (uint8_t b = 0; b < 4; b++) memset(buffers[b], fill, bytes[b]);
+        out.show(frame.data());
+        reported = out.bytesWritten();
+
+        size_t k = 0;
+        changed.resize(leds.size() * sizeof(CRGB) + target.size() * sizeof(uint16_t) + error.size() + tx.size());
+        for (uint8_t b = 0; b < 4; b++) {
+          for (size_t i = 0; i < bytes[b]; i++, k++) {
+            if (buffers[b][i] != fill) changed[k] = true;
+          }
+        }
+      }
+
+      uint32_t written = 0;
+      for (bool c : changed) written += c;
+      printf("%6s %7u %9u %15u", pathNames[path], n, written, reported);
+
+      // Within 1%, for the bytes rewritten with the value they held
+      if (written > reported || written < reported - reported / 100) {
+        printf("  <- bytesWritten() is off");
+        failures++;
+      }
+      printf("\n");
+    }
+  }
+
+  if (failures) printf("\n%d check(s) failed\n", failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,41 @@
+///////////////////////////////////////////////////////////////////////
+//  Panel layouts validPixelMap() must take and ones it must refuse.
+//  Everything is checked at compile time; the program only says so.
+///////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdint.h>
+#include "panelMap.h"
+
+// The sketch's single 10x6 panel
+constexpr PanelTile single[] = { {0, 0, 10, 6, 0, false, true} };
+static_assert(validPixelMap<60, 10, 6>(single), "single panel refused");
+
+// Two 5x6 panels side by side, the right one upside down
+constexpr PanelTile pair[] = { {0, 0, 5, 6, 0, false, true}, {5, 0, 5, 6, 2, false, true} };
+static_assert(validPixelMap<60, 10, 6>(pair), "side by side panels refused");
+
+// A 6x5 panel turned a quarter each way, making a 10x6 canvas
+constexpr PanelTile turned[] = { {0, 0, 6, 5, 1, true, false}, {5, 0, 6, 5, 3, false, true} };
+static_assert(validPixelMap<60, 10, 6>(turned), "rotated panels refused");
+
+// Right number of LEDs, but half of it hangs off the right edge
+constexpr PanelTile offEdge[] = { {5, 0, 10, 6, 0, false, true} };
+static_assert(!validPixelMap<60, 10, 6>(offEdge), "panel off the canvas let through");
+
+// Fits unrotated, but a quarter turn makes it 6 wide and 10 high
+constexpr PanelTile turnedOff[] = { {0, 0, 10, 6, 1, false, true} };
+static_assert(!validPixelMap<60, 10, 6>(turnedOff), "rotated panel off the canvas let through");
+
+// Both inside, but they overlap by a column and leave one empty
+constexpr PanelTile overlap[] = { {0, 0, 5, 6, 0, false, true}, {4, 0, 5, 6, 0, false, true} };
+static_assert(!validPixelMap<60, 10, 6>(overlap), "overlapping panels let through");
+
+// One panel short of the canvas
+constexpr PanelTile gap[] = { {0, 0, 5, 6, 0, false, true} };
+static_assert(!validPixelMap<60, 10, 6>(gap), "panels with a gap let through");
+
+int main() {
+  printf("panel layouts: ok\n");
+  return 0;
+}
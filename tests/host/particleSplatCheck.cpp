@@ -0,0 +1,62 @@
+///////////////////////////////////////////////////////////////////////
+//  Checks ParticleSplat on the default 10x6 matrix:
+//    - a particle on an LED boundary lights that one LED at its color
+//    - one halfway between lights four at a quarter each
+//    - anywhere on the matrix the LEDs add up to the particle's color,
+//      within the rounding of the four weights
+//    - parts off the matrix are dropped without writing anywhere else
+//    - particles on the same LED add up and saturate
+///////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <vector>
+#include "particleSplat.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char *what) {
+  if (!ok) {
+    printf("  %s\n", what);
+    failures++;
+  }
+}
+
+int main() {
+  const uint16_t w = 10, h = 6, n = w * h;
+  ParticleSplat  splat(w, h);
+  std::vector<CRGB> layer(n + 2);      // A guard pixel each side
+  CRGB *leds = layer.data() + 1;
+
+  fill_solid(layer.data(), n + 2, CRGB::Black);
+  splat.splat(leds, 3 * SPLAT_ONE, 2 * SPLAT_ONE, CRGB(200, 100, 50));
+  check(leds[2 * w + 3] == CRGB(200, 100, 50), "a particle on a boundary isn't one whole LED");
+
+  fill_solid(layer.data(), n + 2, CRGB::Black);
+  splat.splat(leds, 3 * SPLAT_ONE + SPLAT_ONE / 2, 2 * SPLAT_ONE + SPLAT_ONE / 2, CRGB(200, 100, 40));
+  uint16_t corners[] = { 2 * w + 3, 2 * w + 4, 3 * w + 3, 3 * w + 4 };
+  for (uint16_t i : corners) check(leds[i].r >= 49 && leds[i].r <= 50 && leds[i].b >= 9 && leds[i].b <= 10, "a particle halfway isn't four quarters");
+
+  uint32_t badSums = 0, strays = 0;
+  for (uint32_t t = 0; t < 100000; t++) {
+    fill_solid(layer.data(), n + 2, CRGB::Black);
+    int32_t x = random((w + 4) * SPLAT_ONE) - 2 * SPLAT_ONE;
+    int32_t y = random((h + 4) * SPLAT_ONE) - 2 * SPLAT_ONE;
+    splat.splat(leds, x, y, CRGB::White);
+
+    uint32_t sum = 0;
+    for (uint16_t i = 0; i < n; i++) sum += leds[i].r;
+    boolean inside = x >= 0 && y >= 0 && x <= (w - 1) * SPLAT_ONE && y <= (h - 1) * SPLAT_ONE;
+    if (inside && (sum < 252 || sum > 255)) badSums++;
+    if (!inside && sum > 255) badSums++;
+    if (layer[0] || layer[n + 1]) strays++;
+  }
+  check(!badSums, "the LEDs don't add up to the particle's color");
+  check(!strays, "a particle off the matrix wrote past it");
+
+  fill_solid(layer.data(), n + 2, CRGB::Black);
+  for (uint8_t i = 0; i < 10; i++) splat.splat(leds, SPLAT_ONE, SPLAT_ONE, CRGB(100, 0, 0));
+  check(leds[w + 1] == CRGB(255, 0, 0), "particles on one LED don't saturate");
+
+  printf(failures ? "%d check(s) failed\n" : "particle splat: ok\n", failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,114 @@
+///////////////////////////////////////////////////////////////////////
+//  Checks ParticleSystem on the default 10x6 matrix:
+//    - free fall matches y = g t^2 / 2 and v = g t
+//    - a bouncing particle stays on the matrix over 100,000 steps
+//    - an emitter's rate and lifetime give the expected live count
+//    - with WALLS_KILL a particle lives until it is all the way off
+//    - a full pool refuses new particles, and too little scratch makes
+//      claim() fail and update() do nothing
+//    - scratchBytes() is enough wherever the scratch memory starts
+//    - colors drift by the same amount whatever the step size
+///////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "particleSystem.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char *what) {
+  if (!ok) {
+    printf("  %s\n", what);
+    failures++;
+  }
+}
+
+static uint8_t mem[4096];
+
+int main() {
+  const uint16_t w = 10, h = 6;
+  EffectScratch  scratch(mem, sizeof(mem));
+  const ParticleEmitter still = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+  // 12 LEDs/s/s for half a second: 1.5 LEDs down, 6 LEDs/s
+  ParticleParams fall = { 0, 12 * SPLAT_ONE, WALLS_BOUNCE, 255, 0 };
+  ParticleSystem falling(w, h, fall);
+  scratch.reset();
+  check(falling.claim(scratch, 16), "couldn't claim 16 particles");
+  falling.emit(still);
+  for (uint8_t i = 0; i < 25; i++) falling.update(20);
+  check(abs(falling.y[0] - 3 * SPLAT_ONE / 2) <= SPLAT_ONE / 16, "free fall distance is off");
+  check(abs(falling.vy[0] - 6 * SPLAT_ONE) <= SPLAT_ONE / 16, "free fall speed is off");
+
+  boolean escaped = false;
+  for (uint32_t i = 0; i < 100000; i++) {
+    falling.update(20);
+    escaped |= falling.y[0] < 0 || falling.y[0] > (h - 1) * SPLAT_ONE;
+  }
+  check(!escaped && falling.count() == 1, "a bouncing particle left the matrix");
+
+  // 16 a second living half a second is about 8 alive at once
+  ParticleParams  none = { 0, 0, WALLS_KILL, 0, 0 };
+  ParticleEmitter spout = { 5 * SPLAT_ONE, 3 * SPLAT_ONE, 0, 0, 10, 10, 16, 500, 0, 8 };
+  ParticleSystem  sprayed(w, h, none);
+  scratch.reset();
+  sprayed.claim(scratch, 64);
+  sprayed.setEmitters(&spout, 1);
+  for (uint16_t i = 0; i < 500; i++) sprayed.update(20);
+  check(sprayed.count() >= 7 && sprayed.count() <= 9, "emitter rate and lifetime don't give about 8 particles");
+
+  // 1 LED a second to the right from the last column: still partly on
+  // the matrix for most of a second, gone after it
+  ParticleEmitter right = { (w - 1) * SPLAT_ONE, 0, SPLAT_ONE, 0, 0, 0, 0, 0, 0, 0 };
+  ParticleSystem  leaving(w, h, none);
+  scratch.reset();
+  leaving.claim(scratch, 4);
+  leaving.emit(right);
+  for (uint8_t i = 0; i < 45; i++) leaving.update(20);
+  check(leaving.count() == 1, "killed while still partly on the matrix");
+  for (uint8_t i = 0; i < 10; i++) leaving.update(20);
+  check(leaving.count() == 0, "not killed once off the matrix");
+
+  ParticleSystem full(w, h, none);
+  scratch.reset();
+  full.claim(scratch, 3);
+  int16_t last = 0;
+  for (uint8_t i = 0; i < 5; i++) last = full.emit(still);
+  check(last == -1 && full.count() == 3, "a full pool took another particle");
+
+  uint8_t       tiny[50];
+  EffectScratch tinyScratch(tiny, sizeof(tiny));
+  ParticleSystem starved(w, h, none);
+  tinyScratch.reset();
+  check(!starved.claim(tinyScratch, 32) && !starved.ready(), "claimed 32 particles from 50 bytes");
+  starved.setEmitters(&spout, 1);
+  starved.update(20);
+  check(starved.count() == 0, "update() ran without scratch");
+
+  boolean enough = true;
+  for (uint8_t offset = 0; offset < 4; offset++) {
+    for (uint16_t capacity : { 1, 3, 24, 32, 100 }) {
+      EffectScratch  exact(mem + offset, ParticleSystem::scratchBytes(capacity));
+      ParticleSystem sized(w, h, none);
+      exact.reset();
+      enough &= sized.claim(exact, capacity);
+    }
+  }
+  check(enough, "scratchBytes() isn't enough");
+
+  // 20 palette steps a second for 10 seconds, in steps of different sizes
+  ParticleParams drift = { 0, 0, WALLS_BOUNCE, 255, 20 };
+  for (uint16_t step : { 7, 20, 33, 50 }) {
+    ParticleSystem drifting(w, h, drift);
+    scratch.reset();
+    drifting.claim(scratch, 1);
+    drifting.emit(still);
+    for (uint32_t t = 0; t + step <= 10000; t += step) drifting.update(step);
+    uint32_t rest = 10000 % step;
+    if (rest) drifting.update(rest);
+    check(drifting.colorIndex[0] == 200, "color drift depends on the step size");
+  }
+
+  printf(failures ? "%d check(s) failed\n" : "particle system: ok\n", failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,24 @@
+#ifndef __HOST_ADAFRUIT_BLE
+#define __HOST_ADAFRUIT_BLE
+
+// Bluefruit module that never has anything to read
+
+#include "Arduino.h"
+
+#define BLUEFRUIT_MODE_DATA  1
+
+class Adafruit_BLE {
+public:
+  bool begin(bool) { return true; }
+  bool factoryReset() { return true; }
+  void echo(bool) {}
+  void info() {}
+  void verbose(bool) {}
+  bool isVersionAtLeast(const char *) { return true; }
+  bool sendCommandCheckOK(const char *) { return true; }
+  void setMode(int) {}
+  int  available() { return 0; }
+  int  read() { return -1; }
+};
+
+#endif
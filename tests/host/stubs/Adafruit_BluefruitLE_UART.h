@@ -0,0 +1,11 @@
+#ifndef __HOST_ADAFRUIT_BLUEFRUIT_UART
+#define __HOST_ADAFRUIT_BLUEFRUIT_UART
+
+#include "Adafruit_BLE.h"
+
+class Adafruit_BluefruitLE_UART : public Adafruit_BLE {
+public:
+  Adafruit_BluefruitLE_UART(HostSerial &, int) {}
+};
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef __HOST_ARDUINO
+#define __HOST_ARDUINO
+
+///////////////////////////////////////////////////////////////////////
+//  Just enough of the Arduino/Teensy core to build the firmware on a
+//  desktop compiler.  Timing comes from the host clock, and random()
+//  is rand() with a fixed seed so every run is the same.
+///////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string>
+#include "binary.h"
+
+typedef uint8_t  byte;
+typedef bool     boolean;
+
+#define F(x)  (x)
+
+#define constrain(a, lo, hi)  ((a) < (lo) ? (lo) : ((a) > (hi) ? (hi) : (a)))
+#define min(a, b)             ((a) < (b) ? (a) : (b))
+#define max(a, b)             ((a) > (b) ? (a) : (b))
+using std::abs;
+
+// Time
+unsigned long millis();
+unsigned long micros();
+void          delay(unsigned long ms);
+void          delayMicroseconds(unsigned int us);
+
+// Random numbers
+long  random(long howBig);
+long  random(long howSmall, long howBig);
+void  randomSeed(long seed);
+
+// Pins, which do nothing
+#define OUTPUT  1
+#define HIGH    1
+#define LOW     0
+void  pinMode(int pin, int mode);
+void  digitalWrite(int pin, int value);
+void  digitalWriteFast(int pin, int value);
+int   analogRead(int pin);
+
+// Serial output is dropped
+struct HostSerial {
+  void begin(long) {}
+  template <class T> void print(T) {}
+  template <class T, class U> void print(T, U) {}
+  template <class T> void println(T) {}
+  template <class T, class U> void println(T, U) {}
+  void println() {}
+};
+extern HostSerial Serial, Serial2;
+
+// The parts of String the sketch uses
+class String {
+public:
+  String() {}
+  String(const char *s) : _s(s) {}
+  String&     operator=(const char *s) { _s = s; return *this; }
+  String&     operator+=(char c) { _s += c; return *this; }
+  bool        operator==(const char *s) const { return _s == s; }
+  char        operator[](unsigned int i) const { return _s[i]; }
+  const char* c_str() const { return _s.c_str(); }
+  void        toLowerCase() { for (size_t i = 0; i < _s.size(); i++) _s[i] = tolower(_s[i]); }
+  int         indexOf(char c, unsigned int from = 0) const { size_t p = _s.find(c, from); return p == std::string::npos ? -1 : (int)p; }
+  String      substring(unsigned int from) const { String r; r._s = _s.substr(from); return r; }
+  String      substring(unsigned int from, unsigned int to) const { String r; r._s = _s.substr(from, to - from); return r; }
+
+private:
+  std::string _s;
+};
+
+#endif
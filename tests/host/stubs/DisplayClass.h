@@ -0,0 +1,3 @@
+// displayClass.cpp includes its header by this name, which only finds it
+// on a case insensitive file system
+#include "displayClass.h"
@@ -0,0 +1,98 @@
+#ifndef __HOST_FASTLED
+#define __HOST_FASTLED
+
+///////////////////////////////////////////////////////////////////////
+//  The parts of FastLED the firmware uses, with the same types and
+//  8 bit math.  Palettes are made up, since only their shape matters
+//  off the board, and show() sends nothing.
+///////////////////////////////////////////////////////////////////////
+
+#include "Arduino.h"
+
+typedef uint8_t  fract8;
+
+// 8 bit math
+inline uint8_t scale8(uint8_t i, fract8 scale) { return ((uint16_t)i * (1 + (uint16_t)scale)) >> 8; }
+inline uint8_t scale8_video(uint8_t i, fract8 scale) { return (((uint16_t)i * scale) >> 8) + ((i && scale) ? 1 : 0); }
+inline uint8_t qadd8(uint8_t i, uint8_t j) { uint16_t t = i + j; return t > 255 ? 255 : t; }
+inline uint8_t qsub8(uint8_t i, uint8_t j) { int16_t t = i - j; return t < 0 ? 0 : t; }
+inline uint8_t lerp8by8(uint8_t a, uint8_t b, fract8 frac) { return a + (((int16_t)b - a) * frac >> 8); }
+inline uint8_t blend8(uint8_t a, uint8_t b, fract8 amountOfB) { return lerp8by8(a, b, amountOfB); }
+inline uint8_t ease8InOutCubic(fract8 i) { return i; }
+inline uint8_t sin8(uint8_t theta) { return 128 + 127 * sin(theta * M_PI / 128); }
+uint8_t  random8();
+uint8_t  random8(uint8_t lim);
+uint16_t random16();
+
+struct CHSV {
+  uint8_t h, s, v;
+  CHSV(uint8_t ih, uint8_t is, uint8_t iv) : h(ih), s(is), v(iv) {}
+};
+
+struct CRGB {
+  union {
+    struct { uint8_t r, g, b; };
+    uint8_t raw[3];
+  };
+  enum HTMLColorCode { Black = 0x000000, Red = 0xFF0000, Green = 0x008000, Blue = 0x0000FF, White = 0xFFFFFF };
+
+  CRGB() {}
+  constexpr CRGB(uint8_t ir, uint8_t ig, uint8_t ib) : r(ir), g(ig), b(ib) {}
+  CRGB(uint32_t colorcode) : r(colorcode >> 16), g(colorcode >> 8), b(colorcode) {}
+  CRGB(HTMLColorCode colorcode) : r(colorcode >> 16), g(colorcode >> 8), b(colorcode) {}
+  CRGB(const CHSV &hsv) : r(hsv.v), g(scale8(hsv.v, hsv.s)), b(scale8(hsv.v, hsv.h)) {}   // Not a real conversion
+
+  uint8_t&       operator[](uint8_t x) { return raw[x]; }
+  const uint8_t& operator[](uint8_t x) const { return raw[x]; }
+  CRGB&          operator+=(const CRGB &rhs) { r = qadd8(r, rhs.r); g = qadd8(g, rhs.g); b = qadd8(b, rhs.b); return *this; }
+  CRGB&          nscale8(uint8_t scale) { r = scale8(r, scale); g = scale8(g, scale); b = scale8(b, scale); return *this; }
+  CRGB&          nscale8_video(uint8_t scale) { r = scale8_video(r, scale); g = scale8_video(g, scale); b = scale8_video(b, scale); return *this; }
+  CRGB&          fadeToBlackBy(uint8_t fadefactor) { return nscale8(255 - fadefactor); }
+  uint8_t        getAverageLight() const { return (r + g + b) / 3; }
+  explicit operator bool() const { return r || g || b; }
+};
+
+inline bool operator==(const CRGB &lhs, const CRGB &rhs) { return lhs.r == rhs.r && lhs.g == rhs.g && lhs.b == rhs.b; }
+inline bool operator!=(const CRGB &lhs, const CRGB &rhs) { return !(lhs == rhs); }
+inline CRGB operator+(const CRGB &lhs, const CRGB &rhs) { CRGB c = lhs; c += rhs; return c; }
+inline CRGB blend(const CRGB &p1, const CRGB &p2, fract8 amountOfP2) {
+  return CRGB(blend8(p1.r, p2.r, amountOfP2), blend8(p1.g, p2.g, amountOfP2), blend8(p1.b, p2.b, amountOfP2));
+}
+inline void fill_solid(CRGB *leds, int numToFill, const CRGB &color) { for (int i = 0; i < numToFill; i++) leds[i] = color; }
+
+// Palettes
+struct CRGBPalette16 {
+  CRGB entries[16];
+  CRGB&       operator[](uint8_t x) { return entries[x]; }
+  const CRGB& operator[](uint8_t x) const { return entries[x]; }
+  bool        operator==(const CRGBPalette16 &rhs) const { return memcmp(entries, rhs.entries, sizeof(entries)) == 0; }
+  bool        operator!=(const CRGBPalette16 &rhs) const { return !(*this == rhs); }
+};
+enum TBlendType { NOBLEND = 0, LINEARBLEND = 1 };
+extern const CRGBPalette16 RainbowColors_p, CloudColors_p, PartyColors_p, OceanColors_p, LavaColors_p, HeatColors_p, ForestColors_p;
+CRGB ColorFromPalette(const CRGBPalette16 &pal, uint8_t index, uint8_t brightness = 255, TBlendType blendType = LINEARBLEND);
+
+// Controller
+#define TypicalSMD5050    0xFFB0F0
+#define UncorrectedColor  0xFFFFFF
+#define DISABLE_DITHER    0
+enum ESPIChipsets { APA102 };
+
+struct CLEDController {
+  CLEDController& setCorrection(uint32_t) { return *this; }
+  CLEDController& setDither(uint8_t) { return *this; }
+};
+
+struct CFastLED {
+  template <ESPIChipsets CHIPSET, uint8_t DATA_PIN, uint8_t CLOCK_PIN>
+  CLEDController& addLeds(CRGB *, int) { static CLEDController controller; return controller; }
+  void    show() {}
+  void    clear() {}
+  void    setBrightness(uint8_t scale) { _brightness = scale; }
+  uint8_t getBrightness() { return _brightness; }
+  void    setDither(uint8_t) {}
+  uint8_t _brightness = 255;
+};
+extern CFastLED FastLED;
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef __HOST_BINARY
+#define __HOST_BINARY
+
+// Arduino's binary constants, just the six digit ones the font uses
+
+#define B000000  0
+#define B000001  1
+#define B000010  2
+#define B000011  3
+#define B000100  4
+#define B000101  5
+#define B000110  6
+#define B000111  7
+#define B001000  8
+#define B001001  9
+#define B001010  10
+#define B001011  11
+#define B001100  12
+#define B001101  13
+#define B001110  14
+#define B001111  15
+#define B010000  16
+#define B010001  17
+#define B010010  18
+#define B010011  19
+#define B010100  20
+#define B010101  21
+#define B010110  22
+#define B010111  23
+#define B011000  24
+#define B011001  25
+#define B011010  26
+#define B011011  27
+#define B011100  28
+#define B011101  29
+#define B011110  30
+#define B011111  31
+#define B100000  32
+#define B100001  33
+#define B100010  34
+#define B100011  35
+#define B100100  36
+#define B100101  37
+#define B100110  38
+#define B100111  39
+#define B101000  40
+#define B101001  41
+#define B101010  42
+#define B101011  43
+#define B101100  44
+#define B101101  45
+#define B101110  46
+#define B101111  47
+#define B110000  48
+#define B110001  49
+#define B110010  50
+#define B110011  51
+#define B110100  52
+#define B110101  53
+#define B110110  54
+#define B110111  55
+#define B111000  56
+#define B111001  57
+#define B111010  58
+#define B111011  59
+#define B111100  60
+#define B111101  61
+#define B111110  62
+#define B111111  63
+
+#endif
@@ -0,0 +1,46 @@
+///////////////////////////////////////////////////////////////////////
+//  Definitions behind the Arduino and FastLED stubs
+///////////////////////////////////////////////////////////////////////
+
+#include <chrono>
+#include "FastLED.h"
+
+HostSerial  Serial, Serial2;
+CFastLED    FastLED;
+
+static const std::chrono::steady_clock::time_point bootTime = std::chrono::steady_clock::now();
+
+unsigned long micros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - bootTime).count();
+}
+unsigned long millis() { return micros() / 1000; }
+void delay(unsigned long ms) { delayMicroseconds(ms * 1000); }
+void delayMicroseconds(unsigned int us) { unsigned long end = micros() + us; while ((long)(end - micros()) > 0) ; }
+
+long     random(long howBig) { return howBig > 0 ? rand() % howBig : 0; }
+long     random(long howSmall, long howBig) { return howSmall >= howBig ? howSmall : howSmall + random(howBig - howSmall); }
+void     randomSeed(long seed) { srand(seed); }
+uint8_t  random8() { return rand(); }
+uint8_t  random8(uint8_t lim) { return random(lim); }
+uint16_t random16() { return rand(); }
+
+void pinMode(int, int) {}
+void digitalWrite(int, int) {}
+void digitalWriteFast(int, int) {}
+int  analogRead(int) { return 0; }
+
+// Constant so they are set up before any other file's statics copy them.
+// Each palette runs through a different set of colors.
+#define PALETTE(s)  {{ CRGB(0 + s, 255, 30 * s), CRGB(16 + s, 239, 30 * s + 5), CRGB(32 + s, 223, 30 * s + 10), CRGB(48 + s, 207, 30 * s + 15), \
+                       CRGB(64 + s, 191, 30 * s + 20), CRGB(80 + s, 175, 30 * s + 25), CRGB(96 + s, 159, 30 * s + 30), CRGB(112 + s, 143, 30 * s + 35), \
+                       CRGB(128 + s, 127, 30 * s + 40), CRGB(144 + s, 111, 30 * s + 45), CRGB(160 + s, 95, 30 * s + 50), CRGB(176 + s, 79, 30 * s + 55), \
+                       CRGB(192 + s, 63, 30 * s + 60), CRGB(208 + s, 47, 30 * s + 65), CRGB(224 + s, 31, 30 * s + 70), CRGB(240 + s, 15, 30 * s + 75) }}
+const CRGBPalette16 RainbowColors_p = PALETTE(0), CloudColors_p = PALETTE(1), PartyColors_p = PALETTE(2), OceanColors_p = PALETTE(3),
+                    LavaColors_p = PALETTE(4), HeatColors_p = PALETTE(5), ForestColors_p = PALETTE(6);
+
+CRGB ColorFromPalette(const CRGBPalette16 &pal, uint8_t index, uint8_t brightness, TBlendType blendType) {
+  CRGB c = pal[index >> 4];
+  if (blendType == LINEARBLEND) c = blend(c, pal[((index >> 4) + 1) & 15], (index & 15) << 4);
+  if (brightness != 255) c.nscale8_video(brightness);
+  return c;
+}